@@ -3,279 +3,6163 @@
 #define RAYGUI_IMPLEMENTATION
 #include "raygui.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sqlite3.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 #define NUM_OF_COLS 8
 
 typedef struct {
     int id;
     char *name;
-    char *category;
-    char *start_date;
-    char *due_date;
-    char *completion_date;
-    char *status;
-    char *priority;
+    const char *category;       // interned in the connection's CategoryPool, never freed by the caller
+    int category_id;            // filled in on reads; writes go by category name
+    int start_date;             // day numbers (see parse_date), 0 = no date
+    int due_date;
+    int completion_date;
+    uint8_t status;             // codes into the Statuses / Priorities tables, 0 = unset
+    uint8_t priority;
     char *description;
 } Task;
 
-void initialize_db()
+// Codes seeded into every database; further statuses and priorities can be defined at runtime.
+enum { STATUS_TODO = 1, STATUS_IN_PROGRESS, STATUS_DONE };
+enum { PRIORITY_LOW = 1, PRIORITY_MEDIUM, PRIORITY_HIGH };
+
+#define MAX_CODES 256
+
+// Dates are stored as day numbers counted from 0001-01-01 (day 1), so they compare and
+// index as plain integers and 0 is free to mean "no date". julianday() - 1721424.5 gives the
+// same number inside SQL.
+static int days_from_civil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 305;
+}
+
+static void civil_from_days(int days, int *y, int *m, int *d)
+{
+    days += 305;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int doe = days - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+static int read_digits(const char *s, int n)
+{
+    int value = 0;
+    for (int i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + (s[i] - '0');
+    }
+    return value;
+}
+
+// "MM-DD-YYYY" -> day number, or 0 if the text isn't a valid date.
+int parse_date(const char *text)
+{
+    static const int month_days[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    if (!text || strlen(text) != 10 || text[2] != '-' || text[5] != '-') {
+        return 0;
+    }
+
+    int m = read_digits(text, 2);
+    int d = read_digits(text + 3, 2);
+    int y = read_digits(text + 6, 4);
+    if (m < 1 || m > 12 || d < 1 || d > month_days[m - 1] || y < 1) {
+        return 0;
+    }
+    if (m == 2 && d == 29 && (y % 4 != 0 || (y % 100 == 0 && y % 400 != 0))) {
+        return 0;
+    }
+    return days_from_civil(y, m, d);
+}
+
+// Writes the day as "MM-DD-YYYY" (or "" for 0) into buf, which needs 11 bytes.
+char *format_date(int day, char *buf)
+{
+    int y, m, d;
+
+    if (day <= 0) {
+        buf[0] = '\0';
+        return buf;
+    }
+
+    civil_from_days(day, &y, &m, &d);
+    buf[0] = '0' + m / 10;
+    buf[1] = '0' + m % 10;
+    buf[2] = '-';
+    buf[3] = '0' + d / 10;
+    buf[4] = '0' + d % 10;
+    buf[5] = '-';
+    buf[6] = '0' + y / 1000 % 10;
+    buf[7] = '0' + y / 100 % 10;
+    buf[8] = '0' + y / 10 % 10;
+    buf[9] = '0' + y % 10;
+    buf[10] = '\0';
+    return buf;
+}
+
+int today(void)
+{
+    time_t now = time(NULL);
+    struct tm local;
+
+    localtime_r(&now, &local);
+    return days_from_civil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+}
+
+// Markers around the matched terms in search_tasks snippets.
+#define SNIPPET_OPEN "["
+#define SNIPPET_CLOSE "]"
+
+// Statements prepared once in open_db and reused for the lifetime of the connection.
+enum {
+    STMT_INSERT_TASK,
+    STMT_SELECT_TASK,
+    STMT_UPDATE_TASK,
+    STMT_DELETE_TASK,
+    STMT_SET_STATUS,
+    STMT_SELECT_ALL_TASKS,
+    STMT_BEGIN,
+    STMT_COMMIT,
+    STMT_ROLLBACK,
+    STMT_SELECT_CATEGORY_BY_NAME,
+    STMT_SELECT_CATEGORY_BY_ID,
+    STMT_INSERT_CATEGORY,
+    STMT_RENAME_CATEGORY,
+    STMT_PAGE_BY_ID,
+    STMT_PAGE_BY_DUE_DATE,
+    STMT_PAGE_UNDATED,
+    STMT_SEARCH_TASKS,
+    STMT_CHANGES_SINCE,
+    STMT_REGISTER_CONSUMER,
+    STMT_SELECT_CONSUMER,
+    STMT_ACK_CHANGES,
+    STMT_REMOVE_CONSUMER,
+    STMT_TRUNCATE_CHANGES,
+    STMT_DATA_VERSION,
+    NUM_OF_STMTS
+};
+
+static const char *stmt_sql[NUM_OF_STMTS] = {
+    [STMT_INSERT_TASK] = "INSERT INTO Tasks (Name, CategoryId, StartDate, DueDate, CompletionDate, Status, Priority, Description) VALUES (?, ?, ?, ?, ?, ?, ?, ?);",
+    [STMT_SELECT_TASK] = "SELECT Id, Name, CategoryId, StartDate, DueDate, CompletionDate, Status, Priority, Description FROM Tasks WHERE Id = ?;",
+    // NULL parameters leave the column as it is, so one statement serves any partial edit.
+    [STMT_UPDATE_TASK] = "UPDATE Tasks SET Name = COALESCE(?, Name), CategoryId = COALESCE(?, CategoryId), "
+                         "StartDate = COALESCE(?, StartDate), DueDate = COALESCE(?, DueDate), "
+                         "CompletionDate = COALESCE(?, CompletionDate), Status = COALESCE(?, Status), "
+                         "Priority = COALESCE(?, Priority), Description = COALESCE(?, Description) WHERE Id = ?;",
+    [STMT_DELETE_TASK] = "DELETE FROM Tasks WHERE Id = ?;",
+    // Status 0 (none) is stored as NULL, as bind_code does; run_for_ids binds a plain int.
+    [STMT_SET_STATUS] = "UPDATE Tasks SET Status = NULLIF(?, 0) WHERE Id = ?;",
+    [STMT_SELECT_ALL_TASKS] = "SELECT Id, Name, CategoryId, StartDate, DueDate, CompletionDate, Status, Priority, Description FROM Tasks;",
+    [STMT_BEGIN] = "BEGIN IMMEDIATE;",
+    [STMT_COMMIT] = "COMMIT;",
+    [STMT_ROLLBACK] = "ROLLBACK;",
+    [STMT_SELECT_CATEGORY_BY_NAME] = "SELECT Id FROM Categories WHERE Name = ?;",
+    [STMT_SELECT_CATEGORY_BY_ID] = "SELECT Name FROM Categories WHERE Id = ?;",
+    [STMT_INSERT_CATEGORY] = "INSERT INTO Categories (Name) VALUES (?);",
+    [STMT_RENAME_CATEGORY] = "UPDATE Categories SET Name = ? WHERE Id = ?;",
+    [STMT_PAGE_BY_ID] = "SELECT Id, Name, CategoryId, StartDate, DueDate, CompletionDate, Status, Priority, Description FROM Tasks "
+                        "WHERE Id > ? ORDER BY Id LIMIT ?;",
+    [STMT_PAGE_BY_DUE_DATE] = "SELECT Id, Name, CategoryId, StartDate, DueDate, CompletionDate, Status, Priority, Description FROM Tasks "
+                              "WHERE DueDate IS NOT NULL AND (DueDate, Id) > (?, ?) ORDER BY DueDate, Id LIMIT ?;",
+    [STMT_PAGE_UNDATED] = "SELECT Id, Name, CategoryId, StartDate, DueDate, CompletionDate, Status, Priority, Description FROM Tasks "
+                          "WHERE DueDate IS NULL AND Id > ? ORDER BY Id LIMIT ?;",
+    [STMT_SEARCH_TASKS] = "SELECT t.Id, t.Name, t.CategoryId, t.StartDate, t.DueDate, t.CompletionDate, t.Status, t.Priority, t.Description, "
+                          "snippet(TasksFts, -1, '" SNIPPET_OPEN "', '" SNIPPET_CLOSE "', '...', 10), rank "
+                          "FROM TasksFts JOIN Tasks t ON t.Id = TasksFts.rowid "
+                          "WHERE TasksFts MATCH ? ORDER BY rank LIMIT ?;",
+    [STMT_CHANGES_SINCE] = "SELECT Seq, TaskId, Op, ChangedAt FROM TaskChanges WHERE Seq > ? ORDER BY Seq LIMIT ?;",
+    [STMT_REGISTER_CONSUMER] = "INSERT OR IGNORE INTO SyncConsumers(Name, AckedSeq) "
+                               "VALUES (?, (SELECT COALESCE(max(Seq), 0) FROM TaskChanges));",
+    [STMT_SELECT_CONSUMER] = "SELECT AckedSeq FROM SyncConsumers WHERE Name = ?;",
+    [STMT_ACK_CHANGES] = "UPDATE SyncConsumers SET AckedSeq = max(AckedSeq, ?) WHERE Name = ?;",
+    [STMT_REMOVE_CONSUMER] = "DELETE FROM SyncConsumers WHERE Name = ?;",
+    // Without consumers min() is NULL and nothing is deleted.
+    [STMT_TRUNCATE_CHANGES] = "DELETE FROM TaskChanges WHERE Seq <= (SELECT min(AckedSeq) FROM SyncConsumers);",
+    [STMT_DATA_VERSION] = "PRAGMA data_version;",
+};
+
+// Fields a TaskFilter can constrain; each combination gets its own cached statement.
+enum {
+    FILTER_CATEGORY = 1 << 0,
+    FILTER_STATUS   = 1 << 1,
+    FILTER_PRIORITY = 1 << 2,
+    FILTER_OPEN     = 1 << 3,
+    FILTER_DUE_FROM = 1 << 4,
+    FILTER_DUE_TO   = 1 << 5,
+    FILTER_COMPLETED_BEFORE = 1 << 6,
+    NUM_OF_FILTER_SHAPES = 1 << 7
+};
+
+// What a filter statement does with the matching tasks.
+enum {
+    FILTER_SELECT,
+    FILTER_DELETE,
+    FILTER_SET_STATUS,
+    NUM_OF_FILTER_OPS
+};
+
+typedef struct {
+    const char *category;
+    uint8_t status;
+    uint8_t priority;
+    int open_only;              // only tasks without a CompletionDate
+    int due_from;               // inclusive day number, 0 = unbounded
+    int due_to;                 // inclusive day number, 0 = unbounded
+    int completed_before;       // exclusive day number, 0 = unbounded
+} TaskFilter;
+
+// Each category name is allocated once per connection and shared by every Task that uses it.
+typedef struct {
+    char **names;               // names[id], NULL where the id is unknown
+    int capacity;
+    size_t count;
+    int *slots;                 // open-addressing hash of ids by case-folded name, 0 = empty
+    size_t num_slots;
+    char **retired;             // names replaced by rename_category; tasks may still point at them
+    size_t num_retired;
+} CategoryPool;
+
+// Tasks by id for get_task_by_id, evicted least recently used first once they take more than
+// max_bytes. Each entry is a single allocation holding the task and then its strings.
+typedef struct TaskCacheEntry {
+    Task task;
+    size_t size;
+    struct TaskCacheEntry *next;    // in the same bucket
+    struct TaskCacheEntry *newer;
+    struct TaskCacheEntry *older;
+} TaskCacheEntry;
+
+#define DEFAULT_TASK_CACHE_BYTES (4 * 1024 * 1024)
+
+typedef struct {
+    TaskCacheEntry **buckets;
+    size_t num_buckets;             // a power of two
+    size_t count;
+    size_t bytes;
+    size_t max_bytes;               // 0 disables caching
+    TaskCacheEntry *newest;
+    TaskCacheEntry *oldest;
+    TaskCacheEntry *scratch;        // the last lookup when it couldn't be cached
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t invalidations;
+} TaskCache;
+
+typedef struct {
+    sqlite3 *conn;
+    sqlite3_stmt *stmts[NUM_OF_STMTS];
+    sqlite3_stmt *filter_stmts[NUM_OF_FILTER_OPS][NUM_OF_FILTER_SHAPES];  // prepared on first use
+    char *status_names[MAX_CODES];                      // loaded from Statuses at open
+    char *priority_names[MAX_CODES];                    // loaded from Priorities at open
+    CategoryPool categories;
+    TaskCache cache;            // kept coherent with this connection's writes by an update hook
+    int data_version;           // last PRAGMA data_version, which moves on other connections' commits
+    size_t commit_interval;     // rows per transaction in add_tasks, 0 = whole batch
+} TodoDb;
+
+// Connection settings applied right after every open.
+typedef struct {
+    const char *name;
+    const char *journal_mode;
+    const char *synchronous;
+    int cache_size;             // PRAGMA cache_size: pages, or KiB when negative
+    const char *temp_store;
+    sqlite3_int64 mmap_size;    // bytes, 0 disables memory-mapped I/O
+    int page_size;              // only takes effect when the database file is created
+} StorageProfile;
+
+static const StorageProfile storage_profiles[] = {
+    {"durable",   "WAL", "FULL",   -2000,  "DEFAULT", 0,                 4096},
+    {"balanced",  "WAL", "NORMAL", -16384, "MEMORY",  64 * 1024 * 1024,  4096},
+    {"bulk-load", "WAL", "OFF",    -65536, "MEMORY",  256 * 1024 * 1024, 4096},
+};
+
+#define DEFAULT_STORAGE_PROFILE "balanced"
+
+const StorageProfile *find_storage_profile(const char *name)
+{
+    for (size_t i = 0; i < sizeof(storage_profiles) / sizeof(storage_profiles[0]); i++) {
+        if (strcmp(storage_profiles[i].name, name) == 0) {
+            return &storage_profiles[i];
+        }
+    }
+    fprintf(stderr, "Unknown storage profile: %s\n", name);
+    return NULL;
+}
+
+int apply_storage_profile(sqlite3 *db, const StorageProfile *profile)
+{
+    char sql[512];
+    char *err_msg = 0;
+
+    // page_size has to come before journal_mode: once the file is in WAL mode it can't change.
+    snprintf(sql, sizeof(sql),
+             "PRAGMA page_size = %d;"
+             "PRAGMA journal_mode = %s;"
+             "PRAGMA synchronous = %s;"
+             "PRAGMA cache_size = %d;"
+             "PRAGMA temp_store = %s;"
+             "PRAGMA mmap_size = %lld;",
+             profile->page_size, profile->journal_mode, profile->synchronous,
+             profile->cache_size, profile->temp_store, (long long)profile->mmap_size);
+
+    int rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to apply storage profile %s: %s\n", profile->name, err_msg);
+        sqlite3_free(err_msg);
+    }
+    return rc;
+}
+
+// A copy of base with TODO_PAGE_SIZE, TODO_CACHE_SIZE and TODO_MMAP_SIZE applied on top, so
+// the I/O settings can be tried on a real todo.db without a rebuild.
+StorageProfile tune_storage_profile(const StorageProfile *base)
+{
+    StorageProfile profile = *base;
+    const char *value;
+
+    if ((value = getenv("TODO_PAGE_SIZE"))) {
+        profile.page_size = atoi(value);
+    }
+    if ((value = getenv("TODO_CACHE_SIZE"))) {
+        profile.cache_size = atoi(value);
+    }
+    if ((value = getenv("TODO_MMAP_SIZE"))) {
+        profile.mmap_size = strtoll(value, NULL, 10);
+    }
+    return profile;
+}
+
+// julianday rolls impossible days over ("02-30" becomes March 2nd), so a date is only kept
+// when its day number formats back to the same text, which rejects what parse_date rejects.
+#define TEXT_DATE_AS_ISO(col) "substr(" col ", 7, 4) || '-' || substr(" col ", 1, 2) || '-' || substr(" col ", 4, 2)"
+#define TEXT_DATE_TO_DAY(col) \
+    "CASE WHEN strftime('%m-%d-%Y', julianday(" TEXT_DATE_AS_ISO(col) ")) = " col " AND substr(" col ", 7, 4) <> '0000' " \
+    "THEN CAST(julianday(" TEXT_DATE_AS_ISO(col) ") - 1721424.5 AS INTEGER) END"
+
+// Schema migrations in order; PRAGMA user_version counts how many have been applied.
+static const char *migrations[] = {
+    // 1: "MM-DD-YYYY" text dates become day numbers. Unparseable dates become NULL.
+    "UPDATE Tasks SET StartDate = " TEXT_DATE_TO_DAY("StartDate") " WHERE typeof(StartDate) = 'text';"
+    "UPDATE Tasks SET DueDate = " TEXT_DATE_TO_DAY("DueDate") " WHERE typeof(DueDate) = 'text';"
+    "UPDATE Tasks SET CompletionDate = " TEXT_DATE_TO_DAY("CompletionDate") " WHERE typeof(CompletionDate) = 'text';",
+
+    // 2: Status and Priority become small integer codes into lookup tables. Tasks is rebuilt
+    // because its TEXT columns would turn the codes back into strings.
+    "CREATE TABLE Statuses(Id INTEGER PRIMARY KEY CHECK (Id BETWEEN 1 AND 255), Name TEXT NOT NULL UNIQUE COLLATE NOCASE);"
+    "CREATE TABLE Priorities(Id INTEGER PRIMARY KEY CHECK (Id BETWEEN 1 AND 255), Name TEXT NOT NULL UNIQUE COLLATE NOCASE);"
+    "INSERT INTO Statuses(Id, Name) VALUES (1, 'Todo'), (2, 'In Progress'), (3, 'Done');"
+    "INSERT INTO Priorities(Id, Name) VALUES (1, 'Low'), (2, 'Medium'), (3, 'High');"
+    "INSERT OR IGNORE INTO Statuses(Name) SELECT DISTINCT Status FROM Tasks WHERE Status IS NOT NULL;"
+    "INSERT OR IGNORE INTO Priorities(Name) SELECT DISTINCT Priority FROM Tasks WHERE Priority IS NOT NULL;"
+    "CREATE TABLE Tasks_v2("
+        "Id INTEGER PRIMARY KEY, Name TEXT NOT NULL, Category TEXT, "
+        "StartDate INTEGER, DueDate INTEGER, CompletionDate INTEGER, "
+        "Status INTEGER REFERENCES Statuses(Id), Priority INTEGER REFERENCES Priorities(Id), Description TEXT);"
+    "INSERT INTO Tasks_v2 SELECT Id, Name, Category, StartDate, DueDate, CompletionDate, "
+        "(SELECT Id FROM Statuses WHERE Name = Tasks.Status), (SELECT Id FROM Priorities WHERE Name = Tasks.Priority), "
+        "Description FROM Tasks;"
+    "DROP TABLE Tasks;"
+    "ALTER TABLE Tasks_v2 RENAME TO Tasks;",
+
+    // 3: Category names move to their own table, referenced by CategoryId.
+    "CREATE TABLE Categories(Id INTEGER PRIMARY KEY, Name TEXT NOT NULL UNIQUE COLLATE NOCASE);"
+    "INSERT OR IGNORE INTO Categories(Name) SELECT DISTINCT Category FROM Tasks WHERE Category IS NOT NULL;"
+    "CREATE TABLE Tasks_v3("
+        "Id INTEGER PRIMARY KEY, Name TEXT NOT NULL, CategoryId INTEGER REFERENCES Categories(Id), "
+        "StartDate INTEGER, DueDate INTEGER, CompletionDate INTEGER, "
+        "Status INTEGER REFERENCES Statuses(Id), Priority INTEGER REFERENCES Priorities(Id), Description TEXT);"
+    "INSERT INTO Tasks_v3 SELECT Id, Name, (SELECT Id FROM Categories WHERE Name = Tasks.Category), "
+        "StartDate, DueDate, CompletionDate, Status, Priority, Description FROM Tasks;"
+    "DROP TABLE Tasks;"
+    "ALTER TABLE Tasks_v3 RENAME TO Tasks;",
+
+    // 4: Full-text index over Name and Description, kept in step with Tasks by triggers.
+    // Matches in the name count ten times as much as matches in the description.
+    "CREATE VIRTUAL TABLE TasksFts USING fts5(Name, Description, content='Tasks', content_rowid='Id');"
+    "INSERT INTO TasksFts(TasksFts, rank) VALUES ('rank', 'bm25(10.0, 1.0)');"
+    "CREATE TRIGGER tasks_fts_insert AFTER INSERT ON Tasks BEGIN "
+        "INSERT INTO TasksFts(rowid, Name, Description) VALUES (new.Id, new.Name, new.Description); END;"
+    "CREATE TRIGGER tasks_fts_delete AFTER DELETE ON Tasks BEGIN "
+        "INSERT INTO TasksFts(TasksFts, rowid, Name, Description) VALUES ('delete', old.Id, old.Name, old.Description); END;"
+    // update_task sets every column, so UPDATE OF alone would fire on every edit.
+    "CREATE TRIGGER tasks_fts_update AFTER UPDATE OF Name, Description ON Tasks "
+        "WHEN old.Name IS NOT new.Name OR old.Description IS NOT new.Description BEGIN "
+        "INSERT INTO TasksFts(TasksFts, rowid, Name, Description) VALUES ('delete', old.Id, old.Name, old.Description); "
+        "INSERT INTO TasksFts(rowid, Name, Description) VALUES (new.Id, new.Name, new.Description); END;"
+    "INSERT INTO TasksFts(TasksFts) VALUES ('rebuild');",
+
+    // 5: Journal of task changes for sync consumers. AUTOINCREMENT keeps sequence numbers
+    // increasing even after the log has been truncated.
+    "CREATE TABLE TaskChanges(Seq INTEGER PRIMARY KEY AUTOINCREMENT, TaskId INTEGER NOT NULL, "
+        "Op INTEGER NOT NULL, ChangedAt INTEGER NOT NULL);"
+    "CREATE TABLE SyncConsumers(Name TEXT PRIMARY KEY, AckedSeq INTEGER NOT NULL DEFAULT 0);"
+    "CREATE TRIGGER tasks_journal_insert AFTER INSERT ON Tasks BEGIN "
+        "INSERT INTO TaskChanges(TaskId, Op, ChangedAt) VALUES (new.Id, 1, CAST(strftime('%s', 'now') AS INTEGER)); END;"
+    "CREATE TRIGGER tasks_journal_update AFTER UPDATE ON Tasks BEGIN "
+        "INSERT INTO TaskChanges(TaskId, Op, ChangedAt) VALUES (new.Id, 2, CAST(strftime('%s', 'now') AS INTEGER)); END;"
+    "CREATE TRIGGER tasks_journal_delete AFTER DELETE ON Tasks BEGIN "
+        "INSERT INTO TaskChanges(TaskId, Op, ChangedAt) VALUES (old.Id, 3, CAST(strftime('%s', 'now') AS INTEGER)); END;",
+
+    // 6: Indexes behind the filter statements. The partial ones cover either open tasks or,
+    // for purging by completion date, completed ones. Files from before schema versioning
+    // of the indexes may already have them.
+    "CREATE INDEX IF NOT EXISTS idx_tasks_due ON Tasks(DueDate);"
+    "CREATE INDEX IF NOT EXISTS idx_tasks_status ON Tasks(Status, DueDate);"
+    "CREATE INDEX IF NOT EXISTS idx_tasks_priority ON Tasks(Priority, DueDate);"
+    "CREATE INDEX IF NOT EXISTS idx_tasks_category ON Tasks(CategoryId, DueDate);"
+    "CREATE INDEX IF NOT EXISTS idx_tasks_open_due ON Tasks(DueDate) WHERE CompletionDate IS NULL;"
+    "CREATE INDEX IF NOT EXISTS idx_tasks_open_category ON Tasks(CategoryId, DueDate) WHERE CompletionDate IS NULL;"
+    "CREATE INDEX IF NOT EXISTS idx_tasks_completed ON Tasks(CompletionDate) WHERE CompletionDate IS NOT NULL;"
+    "CREATE INDEX IF NOT EXISTS idx_tasks_status_completed ON Tasks(Status, CompletionDate) WHERE CompletionDate IS NOT NULL;",
+};
+
+#define NUM_OF_MIGRATIONS (int)(sizeof(migrations) / sizeof(migrations[0]))
+
+static int get_user_version(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int version = -1;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            version = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return version;
+}
+
+static int run_migrations(sqlite3 *db)
+{
+    int version = get_user_version(db);
+    if (version < 0) {
+        fprintf(stderr, "Cannot read schema version: %s\n", sqlite3_errmsg(db));
+        return SQLITE_ERROR;
+    }
+
+    for (; version < NUM_OF_MIGRATIONS; version++) {
+        char *err_msg = 0;
+        char *sql = sqlite3_mprintf("BEGIN IMMEDIATE; %s PRAGMA user_version = %d; COMMIT;", migrations[version], version + 1);
+
+        int rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+        sqlite3_free(sql);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "Migration %d failed: %s\n", version + 1, err_msg);
+            sqlite3_free(err_msg);
+            sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+            return rc;
+        }
+    }
+    return SQLITE_OK;
+}
+
+// The original schema; the migrations bring it (or an older file) up to date.
+#define V0_SCHEMA \
+    "CREATE TABLE IF NOT EXISTS Tasks(" \
+        "Id INTEGER PRIMARY KEY, " \
+        "Name TEXT NOT NULL, " \
+        "Category TEXT, " \
+        "StartDate DATE, " \
+        "DueDate DATE, " \
+        "CompletionDate DATE, " \
+        "Status TEXT, " \
+        "Priority TEXT, " \
+        "Description TEXT);"
+
+// Brings the schema up to date on a read-write connection. A current file costs one
+// PRAGMA read; DDL only runs on new files and ones written by older versions.
+static int ensure_schema(sqlite3 *conn)
+{
+    int version = get_user_version(conn);
+    char *err_msg = 0;
+
+    if (version == NUM_OF_MIGRATIONS) {
+        return SQLITE_OK;
+    }
+    if (version > NUM_OF_MIGRATIONS) {
+        fprintf(stderr, "Database schema version %d is newer than this program (%d)\n", version, NUM_OF_MIGRATIONS);
+        return SQLITE_ERROR;
+    }
+
+    if (sqlite3_exec(conn, V0_SCHEMA, 0, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return SQLITE_ERROR;
+    }
+    return run_migrations(conn);
+}
+
+// Hands out a cached statement, preparing it on first use so opening the database
+// doesn't pay for statements the session never runs; pair every call with release_stmt.
+// Returns NULL if preparing fails, which every caller has to handle.
+static sqlite3_stmt *acquire_stmt(TodoDb *db, int which)
+{
+    if (!db->stmts[which] &&
+        sqlite3_prepare_v3(db->conn, stmt_sql[which], -1, SQLITE_PREPARE_PERSISTENT, &db->stmts[which], NULL) != SQLITE_OK) {
+        fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db->conn));
+        return NULL;
+    }
+    return db->stmts[which];
+}
+
+static void release_stmt(sqlite3_stmt *stmt)
+{
+    if (!stmt) {
+        return;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+const char* get_column_text(sqlite3_stmt *stmt, int col) {
+    const unsigned char* text = sqlite3_column_text(stmt, col);
+    return text ? (const char*)text : NULL;
+}
+
+static char *dup_column_text(sqlite3_stmt *stmt, int col)
+{
+    const char *text = get_column_text(stmt, col);
+    return text ? strdup(text) : NULL;
+}
+
+// FNV-1a over the ASCII-lowercased name, matching the table's COLLATE NOCASE.
+static size_t hash_category_name(const char *name)
+{
+    size_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ (*c >= 'A' && *c <= 'Z' ? *c + 32 : *c)) * 16777619u;
+    }
+    return hash;
+}
+
+static void pool_insert_slot(CategoryPool *pool, int id)
+{
+    size_t mask = pool->num_slots - 1;
+    size_t i = hash_category_name(pool->names[id]) & mask;
+
+    while (pool->slots[i]) {
+        i = (i + 1) & mask;
+    }
+    pool->slots[i] = id;
+}
+
+static int pool_rehash(CategoryPool *pool, size_t num_slots)
+{
+    int *slots = calloc(num_slots, sizeof(int));
+    if (!slots) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return -1;
+    }
+
+    free(pool->slots);
+    pool->slots = slots;
+    pool->num_slots = num_slots;
+    for (int id = 1; id < pool->capacity; id++) {
+        if (pool->names[id]) {
+            pool_insert_slot(pool, id);
+        }
+    }
+    return 0;
+}
+
+// Takes ownership of name and returns the pooled copy, or NULL on allocation failure.
+static const char *pool_add(CategoryPool *pool, int id, char *name)
+{
+    if (!name || id <= 0) {
+        free(name);
+        return NULL;
+    }
+
+    if (id >= pool->capacity) {
+        int capacity = pool->capacity ? pool->capacity : 64;
+        while (capacity <= id) {
+            capacity *= 2;
+        }
+        char **names = realloc(pool->names, capacity * sizeof(char *));
+        if (!names) {
+            fprintf(stderr, "Failed to realloc memory\n");
+            free(name);
+            return NULL;
+        }
+        memset(names + pool->capacity, 0, (capacity - pool->capacity) * sizeof(char *));
+        pool->names = names;
+        pool->capacity = capacity;
+    }
+
+    free(pool->names[id]);
+    pool->names[id] = name;
+    pool->count++;
+
+    // Keep the hash at most half full.
+    if (pool->count * 2 > pool->num_slots) {
+        if (pool_rehash(pool, pool->num_slots ? pool->num_slots * 2 : 128) < 0) {
+            return NULL;
+        }
+    } else {
+        pool_insert_slot(pool, id);
+    }
+    return name;
+}
+
+// Swaps in a new name for id. Tasks already handed out keep pointing at the old string, so
+// it is parked until the pool is freed.
+static const char *pool_replace(CategoryPool *pool, int id, char *name)
+{
+    char **retired = realloc(pool->retired, (pool->num_retired + 1) * sizeof(char *));
+    if (!retired) {
+        fprintf(stderr, "Failed to realloc memory\n");
+        free(name);
+        return NULL;
+    }
+    pool->retired = retired;
+    pool->retired[pool->num_retired++] = pool->names[id];
+    pool->names[id] = NULL;
+    pool->count--;
+    pool_rehash(pool, pool->num_slots);
+    return pool_add(pool, id, name);
+}
+
+static int pool_find(const CategoryPool *pool, const char *name)
+{
+    if (!pool->num_slots) {
+        return 0;
+    }
+
+    size_t mask = pool->num_slots - 1;
+    for (size_t i = hash_category_name(name) & mask; pool->slots[i]; i = (i + 1) & mask) {
+        int id = pool->slots[i];
+        if (pool->names[id] && strcasecmp(pool->names[id], name) == 0) {
+            return id;
+        }
+    }
+    return 0;
+}
+
+// Fills the pool from Categories. Run again, it picks up categories that other connections
+// have added or renamed since.
+static int load_categories(TodoDb *db)
+{
+    CategoryPool *pool = &db->categories;
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(db->conn, "SELECT Id, Name FROM Categories;", -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Cannot load Categories: %s\n", sqlite3_errmsg(db->conn));
+        return SQLITE_ERROR;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int id = sqlite3_column_int(stmt, 0);
+        const char *name = get_column_text(stmt, 1);
+        if (id >= pool->capacity || !pool->names[id]) {
+            pool_add(pool, id, dup_column_text(stmt, 1));
+        } else if (name && strcmp(pool->names[id], name) != 0) {
+            pool_replace(pool, id, dup_column_text(stmt, 1));
+        }
+    }
+    sqlite3_finalize(stmt);
+    return SQLITE_OK;
+}
+
+static void free_category_pool(CategoryPool *pool)
+{
+    for (int i = 0; i < pool->capacity; i++) {
+        free(pool->names[i]);
+    }
+    for (size_t i = 0; i < pool->num_retired; i++) {
+        free(pool->retired[i]);
+    }
+    free(pool->names);
+    free(pool->slots);
+    free(pool->retired);
+    memset(pool, 0, sizeof(*pool));
+}
+
+static size_t task_cache_bucket(int id, size_t num_buckets)
+{
+    return ((uint32_t)id * 2654435761u) & (num_buckets - 1);
+}
+
+static TaskCacheEntry **task_cache_slot(TaskCache *cache, int id)
+{
+    TaskCacheEntry **slot = &cache->buckets[task_cache_bucket(id, cache->num_buckets)];
+
+    while (*slot && (*slot)->task.id != id) {
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+static void task_cache_unlink(TaskCache *cache, TaskCacheEntry *entry)
+{
+    *(entry->newer ? &entry->newer->older : &cache->newest) = entry->older;
+    *(entry->older ? &entry->older->newer : &cache->oldest) = entry->newer;
+}
+
+static void task_cache_push(TaskCache *cache, TaskCacheEntry *entry)
+{
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    *(cache->newest ? &cache->newest->newer : &cache->oldest) = entry;
+    cache->newest = entry;
+}
+
+// Removes the entry *slot points at.
+static void task_cache_remove(TaskCache *cache, TaskCacheEntry **slot)
+{
+    TaskCacheEntry *entry = *slot;
+
+    *slot = entry->next;
+    task_cache_unlink(cache, entry);
+    cache->count--;
+    cache->bytes -= entry->size;
+    free(entry);
+}
+
+static void task_cache_evict(TaskCache *cache)
+{
+    while (cache->bytes > cache->max_bytes && cache->oldest) {
+        task_cache_remove(cache, task_cache_slot(cache, cache->oldest->task.id));
+        cache->evictions++;
+    }
+}
+
+static void task_cache_invalidate(TaskCache *cache, int id)
+{
+    if (cache->count) {
+        TaskCacheEntry **slot = task_cache_slot(cache, id);
+        if (*slot) {
+            task_cache_remove(cache, slot);
+            cache->invalidations++;
+        }
+    }
+}
+
+static void task_cache_clear(TaskCache *cache)
+{
+    while (cache->oldest) {
+        task_cache_remove(cache, task_cache_slot(cache, cache->oldest->task.id));
+    }
+}
+
+static void free_task_cache(TaskCache *cache)
+{
+    task_cache_clear(cache);
+    free(cache->buckets);
+    free(cache->scratch);
+    cache->buckets = NULL;
+    cache->scratch = NULL;
+    cache->num_buckets = 0;
+}
+
+static const Task *task_cache_find(TaskCache *cache, int id)
+{
+    TaskCacheEntry *entry = cache->count ? *task_cache_slot(cache, id) : NULL;
+
+    if (!entry) {
+        cache->misses++;
+        return NULL;
+    }
+    task_cache_unlink(cache, entry);
+    task_cache_push(cache, entry);
+    cache->hits++;
+    return &entry->task;
+}
+
+// Copies a (possibly borrowed) task into the cache, replacing any copy with the same id, or
+// into the scratch entry if it doesn't fit or the table can't grow. Short of memory, the old
+// scratch block is reused when it is big enough; NULL means the task couldn't be kept at all.
+static const Task *task_cache_put(TaskCache *cache, const Task *task)
+{
+    size_t name_size = task->name ? strlen(task->name) + 1 : 0;
+    size_t description_size = task->description ? strlen(task->description) + 1 : 0;
+    size_t size = sizeof(TaskCacheEntry) + name_size + description_size;
+
+    if (cache->count) {
+        TaskCacheEntry **slot = task_cache_slot(cache, task->id);
+        if (*slot) {
+            task_cache_remove(cache, slot);
+        }
+    }
+
+    TaskCacheEntry *entry = malloc(size);
+    if (!entry) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        if (!cache->scratch || cache->scratch->size < size) {
+            return NULL;
+        }
+        entry = cache->scratch;
+        cache->scratch = NULL;
+        size = entry->size;
+    }
+    entry->task = *task;
+    entry->size = size;
+    entry->task.name = name_size ? memcpy((char *)(entry + 1), task->name, name_size) : NULL;
+    entry->task.description = description_size ? memcpy((char *)(entry + 1) + name_size, task->description, description_size) : NULL;
+
+    TaskCacheEntry **buckets = NULL;
+    size_t num_buckets = 0;
+
+    if (size <= cache->max_bytes && cache->count >= cache->num_buckets) {
+        num_buckets = cache->num_buckets ? cache->num_buckets * 2 : 256;
+        buckets = calloc(num_buckets, sizeof(*buckets));
+        if (!buckets) {
+            fprintf(stderr, "Failed to allocate memory\n");
+        }
+    }
+    if (size > cache->max_bytes || (num_buckets && !buckets)) {
+        free(cache->scratch);
+        cache->scratch = entry;
+        return &entry->task;
+    }
+
+    if (buckets) {
+        for (size_t i = 0; i < cache->num_buckets; i++) {
+            while (cache->buckets[i]) {
+                TaskCacheEntry *moved = cache->buckets[i];
+                cache->buckets[i] = moved->next;
+                size_t bucket = task_cache_bucket(moved->task.id, num_buckets);
+                moved->next = buckets[bucket];
+                buckets[bucket] = moved;
+            }
+        }
+        free(cache->buckets);
+        cache->buckets = buckets;
+        cache->num_buckets = num_buckets;
+    }
+
+    TaskCacheEntry **slot = task_cache_slot(cache, task->id);
+    entry->next = NULL;
+    *slot = entry;
+    task_cache_push(cache, entry);
+    cache->count++;
+    cache->bytes += size;
+    task_cache_evict(cache);
+    return &entry->task;
+}
+
+// Any change to a task drops its cached copy; renaming a category drops them all, since
+// cached tasks still point at the old name. Only writes on this connection are seen.
+static void on_table_change(void *arg, int op, const char *database, const char *table, sqlite3_int64 rowid)
+{
+    TodoDb *db = arg;
+
+    if (strcmp(table, "Tasks") == 0) {
+        task_cache_invalidate(&db->cache, (int)rowid);
+    } else if (strcmp(table, "Categories") == 0 && op != SQLITE_INSERT) {
+        task_cache_clear(&db->cache);
+    }
+}
+
+// Rows cached inside a transaction may hold changes it just threw away, and the update hook
+// doesn't fire for a rollback, so start the cache over.
+static void on_rollback(void *arg)
+{
+    TodoDb *db = arg;
+
+    task_cache_clear(&db->cache);
+}
+
+// Caps the memory held by cached tasks (0 turns caching off), evicting as needed.
+void set_task_cache_limit(TodoDb *db, size_t max_bytes)
+{
+    db->cache.max_bytes = max_bytes;
+    task_cache_evict(&db->cache);
+}
+
+void close_db(TodoDb *db)
+{
+    if (!db) {
+        return;
+    }
+
+    for (int i = 0; i < NUM_OF_STMTS; i++) {
+        sqlite3_finalize(db->stmts[i]);
+    }
+    for (int op = 0; op < NUM_OF_FILTER_OPS; op++) {
+        for (int i = 0; i < NUM_OF_FILTER_SHAPES; i++) {
+            sqlite3_finalize(db->filter_stmts[op][i]);
+        }
+    }
+    for (int i = 0; i < MAX_CODES; i++) {
+        free(db->status_names[i]);
+        free(db->priority_names[i]);
+    }
+    free_category_pool(&db->categories);
+    free_task_cache(&db->cache);
+
+    sqlite3_close(db->conn);
+    free(db);
+}
+
+// Fills names[code] from a Statuses/Priorities style (Id, Name) table.
+static int load_code_table(sqlite3 *conn, const char *table, char *names[MAX_CODES])
+{
+    sqlite3_stmt *stmt;
+    char *sql = sqlite3_mprintf("SELECT Id, Name FROM %s;", table);
+    int rc = sqlite3_prepare_v2(conn, sql, -1, &stmt, NULL);
+
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Cannot load %s: %s\n", table, sqlite3_errmsg(conn));
+        return rc;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int code = sqlite3_column_int(stmt, 0);
+        // Codes are never renamed, so a reload only has to pick up new ones.
+        if (code > 0 && code < MAX_CODES && !names[code]) {
+            names[code] = strdup((const char *)sqlite3_column_text(stmt, 1));
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    return SQLITE_OK;
+}
+
+static int read_data_version(TodoDb *db)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_DATA_VERSION);
+    int version = -1;
+
+    if (!stmt) {
+        return version;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    release_stmt(stmt);
+    return version;
+}
+
+// Everything after sqlite3_open_v2 that turns a connection into a usable TodoDb.
+static TodoDb *finish_open(TodoDb *db, const StorageProfile *profile, int flags)
+{
+    // The profile goes first so that a brand-new file gets its page size.
+    if (apply_storage_profile(db->conn, profile) != SQLITE_OK) {
+        close_db(db);
+        return NULL;
+    }
+
+    if (flags & SQLITE_OPEN_READONLY) {
+        if (get_user_version(db->conn) != NUM_OF_MIGRATIONS) {
+            fprintf(stderr, "Database schema is not current; open it read-write first\n");
+            close_db(db);
+            return NULL;
+        }
+    } else if (ensure_schema(db->conn) != SQLITE_OK) {
+        close_db(db);
+        return NULL;
+    }
+
+    if (load_code_table(db->conn, "Statuses", db->status_names) != SQLITE_OK ||
+        load_code_table(db->conn, "Priorities", db->priority_names) != SQLITE_OK ||
+        load_categories(db) != SQLITE_OK) {
+        close_db(db);
+        return NULL;
+    }
+
+    db->cache.max_bytes = DEFAULT_TASK_CACHE_BYTES;
+    db->data_version = read_data_version(db);
+    sqlite3_update_hook(db->conn, on_table_change, db);
+    sqlite3_rollback_hook(db->conn, on_rollback, db);
+    return db;
+}
+
+static TodoDb *open_connection(const char *path, const StorageProfile *profile, int flags)
+{
+    TodoDb *db = calloc(1, sizeof(TodoDb));
+    if (!db) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+
+    if (sqlite3_open_v2(path, &db->conn, flags, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Error opening: %s\n", sqlite3_errmsg(db->conn));
+        close_db(db);
+        return NULL;
+    }
+    return finish_open(db, profile, flags);
+}
+
+TodoDb *open_db(const char *path, const StorageProfile *profile)
+{
+    return open_connection(path, profile, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+}
+
+// PRAGMA page_size is ignored on an existing file unless a VACUUM rebuilds it, and VACUUM
+// can't change it in WAL mode, so step out of WAL for the rebuild and back in afterwards.
+// Needs every other connection to the file closed.
+int change_page_size(TodoDb *db, int page_size)
+{
+    char journal_mode[16] = "delete";
+    char sql[256];
+    char *err_msg = 0;
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(db->conn, "PRAGMA journal_mode;", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW && get_column_text(stmt, 0)) {
+        snprintf(journal_mode, sizeof(journal_mode), "%s", get_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+
+    snprintf(sql, sizeof(sql),
+             "PRAGMA journal_mode = DELETE;"
+             "PRAGMA page_size = %d;"
+             "VACUUM;"
+             "PRAGMA journal_mode = %s;",
+             page_size, journal_mode);
+
+    int rc = sqlite3_exec(db->conn, sql, 0, 0, &err_msg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Cannot change page size: %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+    return rc;
+}
+
+static int get_page_size(sqlite3 *conn)
+{
+    sqlite3_stmt *stmt;
+    int page_size = 0;
+
+    if (sqlite3_prepare_v2(conn, "PRAGMA page_size;", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        page_size = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return page_size;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Copies src into dst with the online backup API, pages_per_step pages at a time (-1 for all
+// at once). Between steps the source connection's mutex is free, so its owner keeps running.
+// A commit to an in-memory source sends the copy back to page one, so every restart doubles
+// the step: a busy owner makes the copy coarser, but can't keep it from finishing.
+static int copy_database(sqlite3 *dst, sqlite3 *src, int pages_per_step)
+{
+    sqlite3_backup *backup = sqlite3_backup_init(dst, "main", src, "main");
+    int remaining = -1;
+    int rc;
+
+    if (!backup) {
+        fprintf(stderr, "Cannot start backup: %s\n", sqlite3_errmsg(dst));
+        return SQLITE_ERROR;
+    }
+
+    while ((rc = sqlite3_backup_step(backup, pages_per_step)) != SQLITE_DONE) {
+        if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            // The owner is inside a transaction; the step will succeed once it commits.
+            usleep(1000);
+        } else if (rc == SQLITE_OK) {
+            if (remaining >= 0 && sqlite3_backup_remaining(backup) > remaining && pages_per_step < 1 << 24) {
+                pages_per_step *= 2;
+            }
+            remaining = sqlite3_backup_remaining(backup);
+            sched_yield();
+        } else {
+            break;
+        }
+    }
+
+    if (sqlite3_backup_finish(backup) != SQLITE_OK || rc != SQLITE_DONE) {
+        fprintf(stderr, "Backup failed: %s\n", sqlite3_errmsg(dst));
+        return SQLITE_ERROR;
+    }
+    return SQLITE_OK;
+}
+
+// Loads path into a private in-memory database and runs the session there, so no read or write
+// waits on the disk. Nothing goes back to the file until a TodoSnapshotter copies it. The
+// connection is fully mutexed because the snapshot thread reads it alongside its owner.
+TodoDb *open_memory_db(const char *path, const StorageProfile *profile)
+{
+    sqlite3 *file = NULL;
+    TodoDb *db = calloc(1, sizeof(TodoDb));
+    if (!db) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+
+    if (sqlite3_open_v2(":memory:", &db->conn, SQLITE_OPEN_READWRITE | SQLITE_OPEN_FULLMUTEX, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Error opening: %s\n", sqlite3_errmsg(db->conn));
+        close_db(db);
+        return NULL;
+    }
+
+    // A missing file just means starting empty; the first snapshot creates it.
+    if (sqlite3_open_v2(path, &file, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK) {
+        char sql[64];
+
+        // A backup can't change an in-memory destination's page size, so match the file first.
+        snprintf(sql, sizeof(sql), "PRAGMA page_size = %d;", get_page_size(file));
+        if (sqlite3_exec(db->conn, sql, 0, 0, NULL) != SQLITE_OK ||
+            copy_database(db->conn, file, -1) != SQLITE_OK) {
+            sqlite3_close(file);
+            close_db(db);
+            return NULL;
+        }
+    }
+    sqlite3_close(file);
+
+    return finish_open(db, profile, SQLITE_OPEN_READWRITE);
+}
+
+typedef struct {
+    size_t snapshots;
+    double last_seconds;
+    double max_seconds;
+    double total_seconds;
+} SnapshotStats;
+
+// Copies an open_memory_db session back to its file from a background thread. The most work a
+// crash can lose is one interval plus however long the snapshot in flight takes.
+typedef struct {
+    TodoDb *db;
+    sqlite3 *staging;           // in-memory copy the file is written from, so disk I/O never holds up db
+    sqlite3 *file;
+    double interval;            // seconds between snapshots
+    int pages_per_step;         // the longest the owner can wait on a snapshot is one step
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // stopping
+    int stopping;
+    sqlite3_int64 saved_changes;    // total_changes when the last snapshot started
+    SnapshotStats stats;
+} TodoSnapshotter;
+
+#define DEFAULT_SNAPSHOT_PAGES 64
+
+// Only the copy into staging competes with the owner for its connection; writing staging out
+// to the file happens entirely on this thread. Costs a second copy of the database in memory.
+static void take_snapshot(TodoSnapshotter *snapshotter)
+{
+    sqlite3_int64 changes = sqlite3_total_changes64(snapshotter->db->conn);
+    if (changes == snapshotter->saved_changes) {
+        return;
+    }
+
+    double start = now_seconds();
+    if (copy_database(snapshotter->staging, snapshotter->db->conn, snapshotter->pages_per_step) != SQLITE_OK ||
+        copy_database(snapshotter->file, snapshotter->staging, snapshotter->pages_per_step) != SQLITE_OK) {
+        return;
+    }
+    double elapsed = now_seconds() - start;
+
+    pthread_mutex_lock(&snapshotter->lock);
+    snapshotter->saved_changes = changes;
+    snapshotter->stats.snapshots++;
+    snapshotter->stats.last_seconds = elapsed;
+    snapshotter->stats.total_seconds += elapsed;
+    if (elapsed > snapshotter->stats.max_seconds) {
+        snapshotter->stats.max_seconds = elapsed;
+    }
+    pthread_mutex_unlock(&snapshotter->lock);
+}
+
+static void *snapshotter_main(void *arg)
+{
+    TodoSnapshotter *snapshotter = arg;
+
+    for (;;) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (time_t)snapshotter->interval;
+        deadline.tv_nsec += (long)((snapshotter->interval - (time_t)snapshotter->interval) * 1e9);
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        pthread_mutex_lock(&snapshotter->lock);
+        while (!snapshotter->stopping &&
+               pthread_cond_timedwait(&snapshotter->wake, &snapshotter->lock, &deadline) == 0) {
+        }
+        int stop = snapshotter->stopping;
+        pthread_mutex_unlock(&snapshotter->lock);
+
+        // Stopping still takes a snapshot on the way out, even if it came before the first wait.
+        take_snapshot(snapshotter);
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Snapshots db to path every interval seconds while it has changes. The owner keeps using db
+// as before, but must call stop_snapshots before close_db.
+TodoSnapshotter *start_snapshots(TodoDb *db, const char *path, const StorageProfile *profile,
+                                 double interval, int pages_per_step)
+{
+    TodoSnapshotter *snapshotter = calloc(1, sizeof(TodoSnapshotter));
+    if (!snapshotter) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+
+    char sql[64];
+    snprintf(sql, sizeof(sql), "PRAGMA page_size = %d;", get_page_size(db->conn));
+
+    if (sqlite3_open_v2(":memory:", &snapshotter->staging, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK ||
+        sqlite3_exec(snapshotter->staging, sql, 0, 0, NULL) != SQLITE_OK ||
+        sqlite3_open_v2(path, &snapshotter->file, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK ||
+        apply_storage_profile(snapshotter->file, profile) != SQLITE_OK) {
+        fprintf(stderr, "Cannot open snapshot target %s\n", path);
+        sqlite3_close(snapshotter->staging);
+        sqlite3_close(snapshotter->file);
+        free(snapshotter);
+        return NULL;
+    }
+
+    snapshotter->db = db;
+    snapshotter->interval = interval;
+    snapshotter->pages_per_step = pages_per_step;
+    pthread_mutex_init(&snapshotter->lock, NULL);
+    pthread_cond_init(&snapshotter->wake, NULL);
+
+    if (pthread_create(&snapshotter->thread, NULL, snapshotter_main, snapshotter) != 0) {
+        fprintf(stderr, "Cannot start snapshot thread\n");
+        pthread_mutex_destroy(&snapshotter->lock);
+        pthread_cond_destroy(&snapshotter->wake);
+        sqlite3_close(snapshotter->staging);
+        sqlite3_close(snapshotter->file);
+        free(snapshotter);
+        return NULL;
+    }
+    return snapshotter;
+}
+
+void get_snapshot_stats(TodoSnapshotter *snapshotter, SnapshotStats *stats)
+{
+    pthread_mutex_lock(&snapshotter->lock);
+    *stats = snapshotter->stats;
+    pthread_mutex_unlock(&snapshotter->lock);
+}
+
+// Takes a final snapshot if anything changed, then stops the thread. stats may be NULL.
+void stop_snapshots(TodoSnapshotter *snapshotter, SnapshotStats *stats)
+{
+    if (!snapshotter) {
+        return;
+    }
+
+    pthread_mutex_lock(&snapshotter->lock);
+    snapshotter->stopping = 1;
+    pthread_cond_signal(&snapshotter->wake);
+    pthread_mutex_unlock(&snapshotter->lock);
+
+    pthread_join(snapshotter->thread, NULL);
+    if (stats) {
+        *stats = snapshotter->stats;
+    }
+    pthread_mutex_destroy(&snapshotter->lock);
+    pthread_cond_destroy(&snapshotter->wake);
+    sqlite3_close(snapshotter->staging);
+    sqlite3_close(snapshotter->file);
+    free(snapshotter);
+}
+
+static uint8_t find_code(char *names[MAX_CODES], const char *name)
+{
+    for (int code = 1; code < MAX_CODES; code++) {
+        if (names[code] && strcasecmp(names[code], name) == 0) {
+            return code;
+        }
+    }
+    return 0;
+}
+
+// Adds name to a code table (or finds it) and returns its code, 0 on failure.
+static uint8_t define_code(TodoDb *db, const char *table, char *names[MAX_CODES], const char *name)
+{
+    uint8_t code = find_code(names, name);
+    if (code) {
+        return code;
+    }
+
+    char *sql = sqlite3_mprintf("INSERT INTO %s (Name) VALUES (%Q);", table, name);
+    char *err_msg = 0;
+    int rc = sqlite3_exec(db->conn, sql, 0, 0, &err_msg);
+
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Cannot add %s to %s: %s\n", name, table, err_msg);
+        sqlite3_free(err_msg);
+        return 0;
+    }
+
+    code = (uint8_t)sqlite3_last_insert_rowid(db->conn);
+    names[code] = strdup(name);
+    return code;
+}
+
+// Interned name for a category id; ids created by other connections are looked up on demand.
+const char *category_name(TodoDb *db, int id)
+{
+    CategoryPool *pool = &db->categories;
+
+    if (id <= 0) {
+        return NULL;
+    }
+    if (id < pool->capacity && pool->names[id]) {
+        return pool->names[id];
+    }
+
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_SELECT_CATEGORY_BY_ID);
+    const char *name = NULL;
+
+    if (!stmt) {
+        return name;
+    }
+    sqlite3_bind_int(stmt, 1, id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        name = pool_add(pool, id, dup_column_text(stmt, 0));
+    }
+    release_stmt(stmt);
+    return name;
+}
+
+// Id of the named category, or 0 if there is none (and create is false).
+int category_id(TodoDb *db, const char *name, int create)
+{
+    int id = pool_find(&db->categories, name);
+    if (id) {
+        return id;
+    }
+
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_SELECT_CATEGORY_BY_NAME);
+    if (!stmt) {
+        return 0;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        id = sqlite3_column_int(stmt, 0);
+    }
+    release_stmt(stmt);
+
+    if (!id && create) {
+        stmt = acquire_stmt(db, STMT_INSERT_CATEGORY);
+        if (!stmt) {
+            return 0;
+        }
+        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_DONE) {
+            id = (int)sqlite3_last_insert_rowid(db->conn);
+        } else {
+            fprintf(stderr, "Cannot add category %s: %s\n", name, sqlite3_errmsg(db->conn));
+        }
+        release_stmt(stmt);
+    }
+
+    if (id) {
+        category_name(db, id);
+    }
+    return id;
+}
+
+// Renames a category for every task that uses it with one single-row update.
+int rename_category(TodoDb *db, const char *old_name, const char *new_name)
+{
+    CategoryPool *pool = &db->categories;
+    int id = category_id(db, old_name, 0);
+    if (!id) {
+        fprintf(stderr, "No such category: %s\n", old_name);
+        return SQLITE_NOTFOUND;
+    }
+
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_RENAME_CATEGORY);
+    if (!stmt) {
+        return SQLITE_ERROR;
+    }
+    sqlite3_bind_text(stmt, 1, new_name, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, id);
+    int rc = sqlite3_step(stmt);
+    release_stmt(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Cannot rename category: %s\n", sqlite3_errmsg(db->conn));
+        return rc;
+    }
+
+    return pool_replace(pool, id, strdup(new_name)) ? SQLITE_OK : SQLITE_NOMEM;
+}
+
+// The update hook only sees this connection's writes. When another connection (or process)
+// has committed since the last call, drop the task cache and reload the lookup tables.
+// Returns 1 if there were such changes.
+int sync_external_changes(TodoDb *db)
+{
+    int version = read_data_version(db);
+
+    if (version == db->data_version) {
+        return 0;
+    }
+    db->data_version = version;
+    task_cache_clear(&db->cache);
+    load_code_table(db->conn, "Statuses", db->status_names);
+    load_code_table(db->conn, "Priorities", db->priority_names);
+    load_categories(db);
+    return 1;
+}
+
+// One writer connection and a fixed set of read-only connections to the same WAL database.
+// Each connection has its own statements and caches and is used by one thread at a time.
+typedef struct {
+    TodoDb *writer;
+    TodoDb **readers;
+    TodoDb **idle;              // stack of readers not checked out
+    size_t num_readers;
+    size_t num_idle;
+    pthread_mutex_t lock;
+    pthread_cond_t reader_available;
+    pthread_mutex_t writer_lock;
+} TodoPool;
+
+void close_pool(TodoPool *pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    for (size_t i = 0; i < pool->num_readers; i++) {
+        close_db(pool->readers[i]);
+    }
+    close_db(pool->writer);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->reader_available);
+    pthread_mutex_destroy(&pool->writer_lock);
+    free(pool->readers);
+    free(pool->idle);
+    free(pool);
+}
+
+// The writer opens (and if need be creates or upgrades) the database before the readers.
+// profile has to use WAL for readers to run alongside the writer.
+TodoPool *open_pool(const char *path, const StorageProfile *profile, size_t num_readers)
+{
+    TodoPool *pool = calloc(1, sizeof(TodoPool));
+    if (!pool) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->reader_available, NULL);
+    pthread_mutex_init(&pool->writer_lock, NULL);
+
+    pool->readers = calloc(num_readers, sizeof(TodoDb *));
+    pool->idle = calloc(num_readers, sizeof(TodoDb *));
+    if (!pool->readers || !pool->idle) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        close_pool(pool);
+        return NULL;
+    }
+
+    // Connections are never shared between threads at once, so SQLite's own mutexes can go.
+    pool->writer = open_connection(path, profile, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX);
+    if (!pool->writer) {
+        close_pool(pool);
+        return NULL;
+    }
+    for (; pool->num_readers < num_readers; pool->num_readers++) {
+        TodoDb *reader = open_connection(path, profile, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX);
+        if (!reader) {
+            close_pool(pool);
+            return NULL;
+        }
+        pool->readers[pool->num_readers] = reader;
+        pool->idle[pool->num_idle++] = reader;
+    }
+    return pool;
+}
+
+// Checks out a read-only connection, waiting for one if they are all in use. Everything
+// read through it (tasks, lists, category names) stays valid until release_reader.
+TodoDb *acquire_reader(TodoPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->num_idle == 0) {
+        pthread_cond_wait(&pool->reader_available, &pool->lock);
+    }
+    TodoDb *reader = pool->idle[--pool->num_idle];
+    pthread_mutex_unlock(&pool->lock);
+
+    sync_external_changes(reader);
+    return reader;
+}
+
+void release_reader(TodoPool *pool, TodoDb *reader)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->idle[pool->num_idle++] = reader;
+    pthread_cond_signal(&pool->reader_available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+TodoDb *acquire_writer(TodoPool *pool)
+{
+    pthread_mutex_lock(&pool->writer_lock);
+    sync_external_changes(pool->writer);
+    return pool->writer;
+}
+
+void release_writer(TodoPool *pool)
+{
+    pthread_mutex_unlock(&pool->writer_lock);
+}
+
+uint8_t status_code(TodoDb *db, const char *name)
+{
+    return find_code(db->status_names, name);
+}
+
+uint8_t priority_code(TodoDb *db, const char *name)
+{
+    return find_code(db->priority_names, name);
+}
+
+const char *status_name(TodoDb *db, uint8_t code)
+{
+    return db->status_names[code];
+}
+
+const char *priority_name(TodoDb *db, uint8_t code)
+{
+    return db->priority_names[code];
+}
+
+uint8_t define_status(TodoDb *db, const char *name)
+{
+    return define_code(db, "Statuses", db->status_names, name);
+}
+
+uint8_t define_priority(TodoDb *db, const char *name)
+{
+    return define_code(db, "Priorities", db->priority_names, name);
+}
+
+static void bind_date(sqlite3_stmt *stmt, int param, int day)
+{
+    if (day > 0) {
+        sqlite3_bind_int(stmt, param, day);
+    } else {
+        sqlite3_bind_null(stmt, param);
+    }
+}
+
+static void bind_code(sqlite3_stmt *stmt, int param, uint8_t code)
+{
+    if (code) {
+        sqlite3_bind_int(stmt, param, code);
+    } else {
+        sqlite3_bind_null(stmt, param);
+    }
+}
+
+// Binds the task's columns to parameters 1..NUM_OF_COLS in table column order, creating its
+// category if need be. Returns -1 if the category can't be created.
+static int bind_task(TodoDb *db, sqlite3_stmt *stmt, const Task *task)
+{
+    sqlite3_bind_text(stmt, 1, task->name, -1, SQLITE_STATIC);
+    if (task->category) {
+        int id = category_id(db, task->category, 1);
+        if (!id) {
+            return -1;
+        }
+        sqlite3_bind_int(stmt, 2, id);
+    } else {
+        sqlite3_bind_null(stmt, 2);
+    }
+    bind_date(stmt, 3, task->start_date);
+    bind_date(stmt, 4, task->due_date);
+    bind_date(stmt, 5, task->completion_date);
+    bind_code(stmt, 6, task->status);
+    bind_code(stmt, 7, task->priority);
+    sqlite3_bind_text(stmt, 8, task->description, -1, SQLITE_STATIC);
+    return 0;
+}
+
+static sqlite3_int64 insert_task(TodoDb *db, Task task)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_INSERT_TASK);
+    sqlite3_int64 id = -1;
+
+    if (!stmt) {
+        return id;
+    }
+    if (bind_task(db, stmt, &task) != 0) {
+        release_stmt(stmt);
+        return id;
+    }
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db->conn));
+    } else {
+        id = sqlite3_last_insert_rowid(db->conn);
+    }
+
+    release_stmt(stmt);
+    return id;
+}
+
+// Returns the new task's id, or -1 on error.
+sqlite3_int64 add_task(TodoDb *db, Task task)
+{
+    return insert_task(db, task);
+}
+
+static int run_stmt(TodoDb *db, int which)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, which);
+    if (!stmt) {
+        return SQLITE_ERROR;
+    }
+    int rc = sqlite3_step(stmt);
+
+    release_stmt(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db->conn));
+        return rc;
+    }
+    return SQLITE_OK;
+}
+
+// Inserts n tasks, committing every db->commit_interval rows (or once for the whole batch).
+// ids, if given, receives each new row id, or -1 for rows that were rolled back.
+// Returns the number of tasks committed. When called inside an open transaction the rows
+// simply join it and the caller decides when to commit: a failing row stops the batch, and
+// the return value and ids cover the rows before it, which are still in the transaction.
+size_t add_tasks(TodoDb *db, const Task *tasks, size_t n, sqlite3_int64 *ids)
+{
+    int own_txn = sqlite3_get_autocommit(db->conn);
+    size_t interval = own_txn && db->commit_interval ? db->commit_interval : n;
+    size_t committed = 0;
+
+    for (size_t start = 0; start < n; start += interval) {
+        size_t end = start + interval < n ? start + interval : n;
+        size_t i;
+
+        if (own_txn && run_stmt(db, STMT_BEGIN) != SQLITE_OK) {
+            break;
+        }
+
+        for (i = start; i < end; i++) {
+            sqlite3_int64 id = insert_task(db, tasks[i]);
+            if (id < 0) {
+                break;
+            }
+            if (ids) {
+                ids[i] = id;
+            }
+        }
+
+        if (i < end || (own_txn && run_stmt(db, STMT_COMMIT) != SQLITE_OK)) {
+            if (own_txn) {
+                run_stmt(db, STMT_ROLLBACK);
+            } else {
+                committed = i;
+            }
+            break;
+        }
+        committed = end;
+    }
+
+    if (ids) {
+        for (size_t i = committed; i < n; i++) {
+            ids[i] = -1;
+        }
+    }
+    return committed;
+}
+
+#define CSV_BUFFER_SIZE (256 * 1024)
+#define MAX_CSV_FIELDS 64
+
+typedef struct {
+    char *text;                 // NUL-terminated in place inside the reader's buffer
+    size_t len;
+} CsvField;
+
+// Reads CSV records through one fixed buffer. A record's fields point straight into that buffer
+// (quoted fields are unescaped where they lie), so they only live until the next read_csv_record.
+// A record has to fit in the buffer whole.
+typedef struct {
+    FILE *file;
+    char *buf;
+    size_t size;                // one byte beyond the data is always free for a terminator
+    size_t start;               // unread data is buf[start, end)
+    size_t end;
+    int eof;
+    size_t line;                // line the next record starts on
+    size_t record_line;         // line the current record started on
+    const char *error;          // why read_csv_record returned -1
+    int num_fields;
+    CsvField fields[MAX_CSV_FIELDS];
+} CsvReader;
+
+int open_csv(CsvReader *reader, FILE *file, size_t buffer_size)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->buf = malloc(buffer_size);
+    if (!reader->buf) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return -1;
+    }
+    reader->file = file;
+    reader->size = buffer_size;
+    reader->line = 1;
+    return 0;
+}
+
+void close_csv(CsvReader *reader)
+{
+    free(reader->buf);
+    reader->buf = NULL;
+}
+
+// Splits buf[start, end) into fields, unescaping quoted ones in place. buf[end] is free to
+// overwrite with the last field's terminator.
+static int split_csv_record(CsvReader *reader, char *p, char *end)
+{
+    if (end > p && end[-1] == '\r') {
+        end--;
+    }
+
+    reader->num_fields = 0;
+    for (;;) {
+        CsvField *field = &reader->fields[reader->num_fields];
+        char *next;
+
+        if (reader->num_fields == MAX_CSV_FIELDS) {
+            reader->error = "too many fields";
+            return -1;
+        }
+
+        if (p < end && *p == '"') {
+            char *out = p;
+            char *in = p + 1;
+
+            field->text = out;
+            for (;;) {
+                if (in == end) {
+                    reader->error = "unterminated quoted field";
+                    return -1;
+                }
+                if (*in == '"') {
+                    if (in + 1 < end && in[1] == '"') {
+                        *out++ = '"';
+                        in += 2;
+                        continue;
+                    }
+                    in++;
+                    break;
+                }
+                *out++ = *in++;
+            }
+            if (in < end && *in != ',') {
+                reader->error = "text after a closing quote";
+                return -1;
+            }
+            next = in;
+            field->len = out - field->text;
+            *out = '\0';
+        } else {
+            next = memchr(p, ',', end - p);
+            if (!next) {
+                next = end;
+            }
+            field->text = p;
+            field->len = next - p;
+        }
+
+        reader->num_fields++;
+        if (next == end) {
+            field->text[field->len] = '\0';
+            return 0;
+        }
+        field->text[field->len] = '\0';
+        p = next + 1;
+    }
+}
+
+// Returns 1 with the next record in reader->fields, 0 at end of input, or -1 for a record that
+// couldn't be read (reader->error says why); reading carries on with the record after it.
+int read_csv_record(CsvReader *reader)
+{
+    size_t scanned = 0;         // bytes of the current record already searched for its end
+    size_t newlines = 0;
+    int quoted = 0;
+    int too_long = 0;
+
+    for (;;) {
+        char *buf = reader->buf;
+        size_t i = reader->start + scanned;
+
+        for (; i < reader->end; i++) {
+            if (buf[i] == '"') {
+                quoted = !quoted;
+            } else if (buf[i] == '\n') {
+                if (!quoted) {
+                    break;
+                }
+                newlines++;
+            }
+        }
+
+        if (i < reader->end || (reader->eof && reader->start < reader->end)) {
+            char *record = buf + reader->start;
+            int rc;
+
+            reader->record_line = reader->line;
+            reader->line += newlines + (i < reader->end);
+            reader->start = i < reader->end ? i + 1 : reader->end;
+            if (too_long) {
+                reader->error = "record is longer than the read buffer";
+                return -1;
+            }
+            rc = split_csv_record(reader, record, buf + i);
+            return rc < 0 ? -1 : 1;
+        }
+        if (reader->eof) {
+            return 0;
+        }
+
+        // Out of data mid-record: slide the partial record to the front and read more.
+        scanned = i - reader->start;
+        if (reader->start > 0) {
+            memmove(buf, buf + reader->start, reader->end - reader->start);
+            reader->end -= reader->start;
+            reader->start = 0;
+        }
+        if (reader->end == reader->size - 1) {
+            // The record can't fit; drop what we have and just look for where it ends.
+            too_long = 1;
+            reader->end = 0;
+            scanned = 0;
+        }
+
+        size_t n = fread(buf + reader->end, 1, reader->size - 1 - reader->end, reader->file);
+        reader->end += n;
+        if (n == 0) {
+            reader->eof = 1;
+            if (ferror(reader->file)) {
+                reader->error = strerror(errno);
+                return -1;
+            }
+        }
+    }
+}
+
+enum {
+    IMPORT_NAME,
+    IMPORT_CATEGORY,
+    IMPORT_START_DATE,
+    IMPORT_DUE_DATE,
+    IMPORT_STATUS,
+    IMPORT_PRIORITY,
+    IMPORT_DESCRIPTION,
+    NUM_OF_IMPORT_FIELDS
+};
+
+static const char *import_field_names[NUM_OF_IMPORT_FIELDS] = {
+    "Name", "Category", "StartDate", "DueDate", "Status", "Priority", "Description",
+};
+
+#define IMPORT_BATCH_ROWS 10000
+
+typedef struct {
+    // Header name or 1-based number of the CSV column for each task field. NULL looks for a
+    // column named like the field itself; "" leaves the field unset.
+    const char *columns[NUM_OF_IMPORT_FIELDS];
+    size_t buffer_size;         // 0 = CSV_BUFFER_SIZE
+    size_t batch_rows;          // rows per transaction, 0 = IMPORT_BATCH_ROWS
+} ImportOptions;
+
+typedef struct {
+    size_t rows;
+    size_t imported;
+    size_t errors;
+    size_t bytes;
+} ImportStats;
+
+// Resolves options->columns against the header record into column indexes, -1 for unset fields.
+static int map_import_columns(const CsvReader *header, const ImportOptions *options, int map[NUM_OF_IMPORT_FIELDS])
+{
+    for (int f = 0; f < NUM_OF_IMPORT_FIELDS; f++) {
+        const char *column = options->columns[f] ? options->columns[f] : import_field_names[f];
+        char *end;
+        long number = strtol(column, &end, 10);
+
+        map[f] = -1;
+        if (!*column) {
+            continue;
+        }
+        if (*end == '\0' && number >= 1 && number <= header->num_fields) {
+            map[f] = (int)number - 1;
+            continue;
+        }
+        for (int c = 0; c < header->num_fields; c++) {
+            if (strcasecmp(header->fields[c].text, column) == 0) {
+                map[f] = c;
+                break;
+            }
+        }
+        if (map[f] < 0 && options->columns[f]) {
+            fprintf(stderr, "No column %s for %s\n", column, import_field_names[f]);
+            return -1;
+        }
+    }
+
+    if (map[IMPORT_NAME] < 0) {
+        fprintf(stderr, "No column for Name\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Fills task from one record. Strings point into the reader's buffer. Returns an error message
+// for a row that can't become a task, NULL on success.
+static const char *parse_import_row(TodoDb *db, const CsvReader *reader, const int map[NUM_OF_IMPORT_FIELDS], Task *task)
+{
+    const char *values[NUM_OF_IMPORT_FIELDS];
+
+    for (int f = 0; f < NUM_OF_IMPORT_FIELDS; f++) {
+        values[f] = map[f] >= 0 && map[f] < reader->num_fields ? reader->fields[map[f]].text : "";
+    }
+
+    memset(task, 0, sizeof(*task));
+    if (!*values[IMPORT_NAME]) {
+        return "missing name";
+    }
+    task->name = (char *)values[IMPORT_NAME];
+    task->category = *values[IMPORT_CATEGORY] ? values[IMPORT_CATEGORY] : NULL;
+    task->description = *values[IMPORT_DESCRIPTION] ? (char *)values[IMPORT_DESCRIPTION] : NULL;
+
+    if (*values[IMPORT_START_DATE] && !(task->start_date = parse_date(values[IMPORT_START_DATE]))) {
+        return "bad start date (expected MM-DD-YYYY)";
+    }
+    if (*values[IMPORT_DUE_DATE] && !(task->due_date = parse_date(values[IMPORT_DUE_DATE]))) {
+        return "bad due date (expected MM-DD-YYYY)";
+    }
+    if (*values[IMPORT_STATUS] && !(task->status = status_code(db, values[IMPORT_STATUS]))) {
+        return "unknown status";
+    }
+    if (*values[IMPORT_PRIORITY] && !(task->priority = priority_code(db, values[IMPORT_PRIORITY]))) {
+        return "unknown priority";
+    }
+    return NULL;
+}
+
+// Streams tasks out of a CSV file whose first record is a header. Each row is inserted as soon
+// as it is parsed, straight from the read buffer, inside transactions of batch_rows rows, so
+// memory use doesn't depend on the file's size. A bad row is reported on stderr as
+// "source:line: reason" and skipped; the rest of its batch still goes in. If a batch can't
+// start its transaction (another writer holding the lock past the busy timeout), the import
+// stops there and that error is returned; batches already committed stay.
+int import_csv(TodoDb *db, FILE *file, const char *source, const ImportOptions *options, ImportStats *stats)
+{
+    size_t batch_rows = options->batch_rows ? options->batch_rows : IMPORT_BATCH_ROWS;
+    size_t pending = 0;
+    int map[NUM_OF_IMPORT_FIELDS];
+    CsvReader reader;
+    int result = SQLITE_OK;
+    int rc;
+
+    memset(stats, 0, sizeof(*stats));
+    if (open_csv(&reader, file, options->buffer_size ? options->buffer_size : CSV_BUFFER_SIZE) != 0) {
+        return SQLITE_NOMEM;
+    }
+
+    rc = read_csv_record(&reader);
+    if (rc <= 0) {
+        fprintf(stderr, "%s: %s\n", source, rc < 0 ? reader.error : "no header");
+        close_csv(&reader);
+        return SQLITE_ERROR;
+    }
+    if (map_import_columns(&reader, options, map) != 0) {
+        close_csv(&reader);
+        return SQLITE_ERROR;
+    }
+
+    while ((rc = read_csv_record(&reader)) != 0) {
+        Task task;
+        const char *error = rc < 0 ? reader.error : NULL;
+
+        if (rc > 0 && reader.num_fields == 1 && reader.fields[0].len == 0) {
+            continue;       // blank line
+        }
+        stats->rows++;
+
+        if (!error) {
+            error = parse_import_row(db, &reader, map, &task);
+        }
+        if (!error) {
+            if (pending == 0 && (result = run_stmt(db, STMT_BEGIN)) != SQLITE_OK) {
+                fprintf(stderr, "%s:%zu: cannot start a transaction, import stopped\n", source, reader.record_line);
+                stats->errors++;
+                break;
+            }
+            if (insert_task(db, task) < 0) {
+                error = "insert failed";
+            } else {
+                pending++;
+            }
+        }
+        if (error) {
+            fprintf(stderr, "%s:%zu: %s\n", source, reader.record_line, error);
+            stats->errors++;
+        }
+
+        if (pending == batch_rows) {
+            if (run_stmt(db, STMT_COMMIT) != SQLITE_OK) {
+                run_stmt(db, STMT_ROLLBACK);
+                fprintf(stderr, "%s:%zu: batch of %zu rows rolled back\n", source, reader.record_line, pending);
+                stats->errors += pending;
+            } else {
+                stats->imported += pending;
+            }
+            pending = 0;
+        }
+    }
+
+    if (pending) {
+        if (run_stmt(db, STMT_COMMIT) != SQLITE_OK) {
+            run_stmt(db, STMT_ROLLBACK);
+            fprintf(stderr, "%s: last batch of %zu rows rolled back\n", source, pending);
+            stats->errors += pending;
+        } else {
+            stats->imported += pending;
+        }
+    }
+
+    long bytes = ftell(file);
+    stats->bytes = bytes > 0 ? (size_t)bytes : 0;
+    close_csv(&reader);
+    return result;
+}
+
+// Points task at the current row of a "SELECT Id, Name, ..., Description" statement.
+// The strings belong to SQLite and only live until the statement steps or resets.
+static void read_task_view(TodoDb *db, sqlite3_stmt *stmt, Task *task)
+{
+    task->id = sqlite3_column_int(stmt, 0);
+    task->name = (char *)get_column_text(stmt, 1);
+    task->category_id = sqlite3_column_int(stmt, 2);
+    task->category = category_name(db, task->category_id);
+    task->start_date = sqlite3_column_int(stmt, 3);
+    task->due_date = sqlite3_column_int(stmt, 4);
+    task->completion_date = sqlite3_column_int(stmt, 5);
+    task->status = (uint8_t)sqlite3_column_int(stmt, 6);
+    task->priority = (uint8_t)sqlite3_column_int(stmt, 7);
+    task->description = (char *)get_column_text(stmt, 8);
+}
+
+void free_task(Task *task)
+{
+    free(task->name);
+    free(task->description);
+    task->name = task->description = NULL;
+}
+
+// Walks query results one row at a time in constant memory. The Task returned by
+// task_cursor_next borrows its strings and is only valid until the next call.
+typedef struct {
+    TodoDb *db;
+    sqlite3_stmt *stmt;
+    int owns_stmt;              // a private statement to finalize, rather than a cached one to reset
+    Task current;
+} TaskCursor;
+
+static void task_cursor_wrap(TaskCursor *cursor, TodoDb *db, sqlite3_stmt *stmt, int owns_stmt)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->db = db;
+    cursor->stmt = stmt;
+    cursor->owns_stmt = owns_stmt;
+}
+
+// Cursor over every task by Id. Uses the cached statement unless another cursor holds it.
+int task_cursor_open(TodoDb *db, TaskCursor *cursor)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_SELECT_ALL_TASKS);
+    int owns_stmt = 0;
+
+    if (!stmt) {
+        return SQLITE_ERROR;
+    }
+    if (sqlite3_stmt_busy(stmt)) {
+        if (sqlite3_prepare_v2(db->conn, stmt_sql[STMT_SELECT_ALL_TASKS], -1, &stmt, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db->conn));
+            return SQLITE_ERROR;
+        }
+        owns_stmt = 1;
+    }
+
+    task_cursor_wrap(cursor, db, stmt, owns_stmt);
+    return SQLITE_OK;
+}
+
+const Task *task_cursor_next(TaskCursor *cursor)
+{
+    int rc = sqlite3_step(cursor->stmt);
+
+    if (rc == SQLITE_ROW) {
+        read_task_view(cursor->db, cursor->stmt, &cursor->current);
+        return &cursor->current;
+    }
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to read tasks: %s\n", sqlite3_errmsg(cursor->db->conn));
+    }
+    return NULL;
+}
+
+void task_cursor_close(TaskCursor *cursor)
+{
+    if (cursor->owns_stmt) {
+        sqlite3_finalize(cursor->stmt);
+    } else if (cursor->stmt) {
+        release_stmt(cursor->stmt);
+    }
+    cursor->stmt = NULL;
+}
+
+// The task with this id, or NULL if there isn't one (or it couldn't be copied for lack of
+// memory, which is reported). The task belongs to the cache and stays valid until the next
+// get_task_by_id or until it is changed; copy what needs to live longer.
+const Task *get_task_by_id(TodoDb *db, int task_id) {
+    const Task *cached = task_cache_find(&db->cache, task_id);
+    if (cached) {
+        return cached;
+    }
+
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_SELECT_TASK);
+    Task task;
+
+    if (!stmt) {
+        return NULL;
+    }
+    sqlite3_bind_int(stmt, 1, task_id);
+
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        read_task_view(db, stmt, &task);
+        cached = task_cache_put(&db->cache, &task);
+    }
+
+    release_stmt(stmt);
+    return cached;
+}
+
+// Updates only the fields set in updated_task (non-NULL strings, non-zero dates and codes).
+// Returns 1 if the task was updated, 0 if there is no task with that id, -1 on error.
+static int update_task(TodoDb *db, int task_id, const Task *updated_task)
+{
+    // A new category is only created once there is a task to put in it.
+    if (updated_task->category && !category_id(db, updated_task->category, 0) && !get_task_by_id(db, task_id)) {
+        return 0;
+    }
+
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_UPDATE_TASK);
+    int result = -1;
+
+    if (!stmt) {
+        return result;
+    }
+    if (bind_task(db, stmt, updated_task) != 0) {
+        release_stmt(stmt);
+        return result;
+    }
+    sqlite3_bind_int(stmt, 9, task_id);
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db->conn));
+    } else {
+        result = sqlite3_changes(db->conn) > 0;
+    }
+
+    release_stmt(stmt);
+    return result;
+}
+
+int edit_task(TodoDb *db, int task_id, Task updated_task) {
+    return update_task(db, task_id, &updated_task);
+}
+
+static const char *or_blank(const char *text)
+{
+    return text && *text ? text : "_";
+}
+
+void list_tasks(TodoDb *db)
+{
+    TaskCursor cursor;
+    const Task *task;
+    char start[11], due[11], completed[11];
+
+    if (task_cursor_open(db, &cursor) != SQLITE_OK) {
+        fprintf(stderr, "Failed to list tasks\n");
+        return;
+    }
+
+    while ((task = task_cursor_next(&cursor))) {
+        printf("Id: %d\nName: %s\nCategory: %s\nStartDate: %s\nDueDate: %s\nCompletionDate: %s\n"
+               "Status: %s\nPriority: %s\nDescription: %s\n\n",
+               task->id, or_blank(task->name), or_blank(task->category),
+               or_blank(format_date(task->start_date, start)),
+               or_blank(format_date(task->due_date, due)),
+               or_blank(format_date(task->completion_date, completed)),
+               or_blank(status_name(db, task->status)), or_blank(priority_name(db, task->priority)),
+               or_blank(task->description));
+    }
+
+    task_cursor_close(&cursor);
+}
+
+#define EXPORT_BUFFER_SIZE (1024 * 1024)
+#define EXPORT_MIN_BUFFER_SIZE (4 * 1024)
+
+// Output staged in one reusable buffer and handed to write(2) a buffer-full at a time.
+typedef struct {
+    int fd;
+    char *buf;
+    size_t size;
+    size_t len;
+    size_t bytes;               // everything written so far
+    size_t writes;              // write(2) calls
+    int failed;
+    uint64_t *checksum;         // if set, FNV-1a of everything written is kept here
+} OutBuffer;
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t n)
+{
+    const unsigned char *p = data;
+
+    for (size_t i = 0; i < n; i++) {
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static int flush_out(OutBuffer *out)
+{
+    size_t done = 0;
+
+    if (out->checksum) {
+        *out->checksum = fnv1a(*out->checksum, out->buf, out->len);
+    }
+    while (done < out->len && !out->failed) {
+        ssize_t n = write(out->fd, out->buf + done, out->len - done);
+        out->writes++;
+        if (n < 0 && errno != EINTR) {
+            fprintf(stderr, "Write failed: %s\n", strerror(errno));
+            out->failed = 1;
+        } else if (n > 0) {
+            done += n;
+        }
+    }
+    out->bytes += done;
+    out->len = 0;
+    return out->failed ? -1 : 0;
+}
+
+// Room for n more bytes at out->buf + out->len; n must not exceed the buffer size.
+static char *reserve_out(OutBuffer *out, size_t n)
+{
+    if (out->len + n > out->size) {
+        flush_out(out);
+    }
+    return out->buf + out->len;
+}
+
+static void put_bytes(OutBuffer *out, const char *text, size_t n)
+{
+    while (n > 0) {
+        size_t room = out->size - out->len;
+        size_t chunk = n < room ? n : room;
+
+        memcpy(out->buf + out->len, text, chunk);
+        out->len += chunk;
+        text += chunk;
+        n -= chunk;
+        if (out->len == out->size && flush_out(out) != 0) {
+            return;
+        }
+    }
+}
+
+static void put_str(OutBuffer *out, const char *text)
+{
+    put_bytes(out, text, strlen(text));
+}
+
+static void put_char(OutBuffer *out, char c)
+{
+    *reserve_out(out, 1) = c;
+    out->len++;
+}
+
+static void put_int(OutBuffer *out, int value)
+{
+    char digits[12];
+    int n = 0;
+    unsigned v = value < 0 ? -(unsigned)value : (unsigned)value;
+
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (value < 0) {
+        digits[n++] = '-';
+    }
+
+    char *p = reserve_out(out, n);
+    for (int i = 0; i < n; i++) {
+        p[i] = digits[n - 1 - i];
+    }
+    out->len += n;
+}
+
+static void put_date(OutBuffer *out, int day)
+{
+    out->len += strlen(format_date(day, reserve_out(out, 11)));
+}
+
+// RFC 4180: quoted only when it has to be, with inner quotes doubled.
+static void put_csv_field(OutBuffer *out, const char *text)
+{
+    if (!text) {
+        return;
+    }
+    size_t n = strcspn(text, ",\"\r\n");
+    if (!text[n]) {
+        put_bytes(out, text, n);
+        return;
+    }
+
+    put_char(out, '"');
+    for (const char *quote; (quote = strchr(text, '"')); text = quote + 1) {
+        put_bytes(out, text, quote + 1 - text);
+        put_char(out, '"');
+    }
+    put_str(out, text);
+    put_char(out, '"');
+}
+
+static void put_json_string(OutBuffer *out, const char *text)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    if (!text) {
+        put_bytes(out, "null", 4);
+        return;
+    }
+
+    put_char(out, '"');
+    for (;;) {
+        const char *run = text;
+        while ((unsigned char)*text >= 0x20 && *text != '"' && *text != '\\') {
+            text++;
+        }
+        put_bytes(out, run, text - run);
+        if (!*text) {
+            break;
+        }
+
+        char *p = reserve_out(out, 6);
+        p[0] = '\\';
+        switch (*text) {
+        case '"': p[1] = '"'; out->len += 2; break;
+        case '\\': p[1] = '\\'; out->len += 2; break;
+        case '\n': p[1] = 'n'; out->len += 2; break;
+        case '\r': p[1] = 'r'; out->len += 2; break;
+        case '\t': p[1] = 't'; out->len += 2; break;
+        default:
+            memcpy(p + 1, "u00", 3);
+            p[4] = hex[(unsigned char)*text >> 4];
+            p[5] = hex[*text & 15];
+            out->len += 6;
+        }
+        text++;
+    }
+    put_char(out, '"');
+}
+
+static void put_json_date(OutBuffer *out, int day)
+{
+    if (day) {
+        put_char(out, '"');
+        put_date(out, day);
+        put_char(out, '"');
+    } else {
+        put_bytes(out, "null", 4);
+    }
+}
+
+typedef enum {
+    EXPORT_CSV,
+    EXPORT_JSONL,
+    EXPORT_MARKDOWN,
+    NUM_OF_EXPORT_FORMATS
+} ExportFormat;
+
+static const char *export_format_names[NUM_OF_EXPORT_FORMATS] = {"csv", "jsonl", "md"};
+
+typedef struct {
+    size_t rows;
+    size_t bytes;
+    size_t writes;
+} ExportStats;
+
+// One row per task. The CSV header matches what import_csv maps by default, so an export
+// imports back as is (less ids and completion dates).
+static void export_task(TodoDb *db, OutBuffer *out, ExportFormat format, const Task *task)
+{
+    switch (format) {
+    case EXPORT_CSV:
+        put_int(out, task->id);
+        put_char(out, ',');
+        put_csv_field(out, task->name);
+        put_char(out, ',');
+        put_csv_field(out, task->category);
+        put_char(out, ',');
+        put_date(out, task->start_date);
+        put_char(out, ',');
+        put_date(out, task->due_date);
+        put_char(out, ',');
+        put_date(out, task->completion_date);
+        put_char(out, ',');
+        put_csv_field(out, status_name(db, task->status));
+        put_char(out, ',');
+        put_csv_field(out, priority_name(db, task->priority));
+        put_char(out, ',');
+        put_csv_field(out, task->description);
+        put_char(out, '\n');
+        break;
+
+    case EXPORT_JSONL:
+        put_bytes(out, "{\"id\":", 6);
+        put_int(out, task->id);
+        put_str(out, ",\"name\":");
+        put_json_string(out, task->name);
+        put_str(out, ",\"category\":");
+        put_json_string(out, task->category);
+        put_str(out, ",\"start_date\":");
+        put_json_date(out, task->start_date);
+        put_str(out, ",\"due_date\":");
+        put_json_date(out, task->due_date);
+        put_str(out, ",\"completion_date\":");
+        put_json_date(out, task->completion_date);
+        put_str(out, ",\"status\":");
+        put_json_string(out, status_name(db, task->status));
+        put_str(out, ",\"priority\":");
+        put_json_string(out, priority_name(db, task->priority));
+        put_str(out, ",\"description\":");
+        put_json_string(out, task->description);
+        put_bytes(out, "}\n", 2);
+        break;
+
+    case EXPORT_MARKDOWN: {
+        // A checklist in the style of todo.md; a line break in a name would end the item.
+        int done = task->completion_date || task->status == STATUS_DONE;
+        const char *name = task->name ? task->name : "";
+
+        put_str(out, done ? "- [x] " : "- [ ] ");
+        for (size_t n; *name; name += n) {
+            n = strcspn(name, "\r\n");
+            put_bytes(out, name, n);
+            if (name[n]) {
+                put_char(out, ' ');
+                n++;
+            }
+        }
+        if (task->due_date) {
+            put_str(out, " (due ");
+            put_date(out, task->due_date);
+            put_char(out, ')');
+        }
+        put_char(out, '\n');
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+// Streams every task to fd through a cursor and one buffer of buffer_size bytes (0 for
+// EXPORT_BUFFER_SIZE, and at least EXPORT_MIN_BUFFER_SIZE, which leaves room for any single
+// reserve_out), so memory use is the same for ten tasks or ten million.
+int export_tasks(TodoDb *db, int fd, ExportFormat format, size_t buffer_size, ExportStats *stats)
+{
+    if (!buffer_size) {
+        buffer_size = EXPORT_BUFFER_SIZE;
+    } else if (buffer_size < EXPORT_MIN_BUFFER_SIZE) {
+        buffer_size = EXPORT_MIN_BUFFER_SIZE;
+    }
+
+    OutBuffer out = {.fd = fd, .size = buffer_size};
+    TaskCursor cursor;
+    const Task *task;
+
+    memset(stats, 0, sizeof(*stats));
+    out.buf = malloc(out.size);
+    if (!out.buf) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return SQLITE_NOMEM;
+    }
+    if (task_cursor_open(db, &cursor) != SQLITE_OK) {
+        free(out.buf);
+        return SQLITE_ERROR;
+    }
+
+    if (format == EXPORT_CSV) {
+        put_str(&out, "Id,Name,Category,StartDate,DueDate,CompletionDate,Status,Priority,Description\n");
+    } else if (format == EXPORT_MARKDOWN) {
+        put_str(&out, "Todo\n\n");
+    }
+    while (!out.failed && (task = task_cursor_next(&cursor))) {
+        export_task(db, &out, format, task);
+        stats->rows++;
+    }
+    flush_out(&out);
+    task_cursor_close(&cursor);
+
+    stats->bytes = out.bytes;
+    stats->writes = out.writes;
+    free(out.buf);
+    return out.failed ? SQLITE_IOERR : SQLITE_OK;
+}
+
+// Returns 1 if the task was deleted, 0 if there was no such task, -1 on error.
+static int remove_task(TodoDb *db, int task_id)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_DELETE_TASK);
+    int result = -1;
+
+    if (!stmt) {
+        return result;
+    }
+    sqlite3_bind_int(stmt, 1, task_id);
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db->conn));
+    } else {
+        result = sqlite3_changes(db->conn) > 0;
+    }
+
+    release_stmt(stmt);
+    return result;
+}
+
+int delete_task(TodoDb *db, int task_id)
+{
+    return remove_task(db, task_id);
+}
+
+// Runs the cached by-id statement once per id, all in one transaction (or the caller's).
+// Binds value to parameter 1 when has_value is set; the id is always the last parameter.
+static int run_for_ids(TodoDb *db, int which, const int *ids, size_t n, int has_value, int value)
+{
+    int own_txn = sqlite3_get_autocommit(db->conn);
+    int affected = 0;
+    size_t i;
+
+    if (own_txn && run_stmt(db, STMT_BEGIN) != SQLITE_OK) {
+        return -1;
+    }
+
+    sqlite3_stmt *stmt = acquire_stmt(db, which);
+    for (i = 0; stmt && i < n; i++) {
+        if (has_value) {
+            sqlite3_bind_int(stmt, 1, value);
+        }
+        sqlite3_bind_int(stmt, has_value ? 2 : 1, ids[i]);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db->conn));
+            break;
+        }
+        affected += sqlite3_changes(db->conn);
+        sqlite3_reset(stmt);
+    }
+    release_stmt(stmt);
+
+    if (i < n || (own_txn && run_stmt(db, STMT_COMMIT) != SQLITE_OK)) {
+        if (own_txn) {
+            run_stmt(db, STMT_ROLLBACK);
+        }
+        return -1;
+    }
+    return affected;
+}
+
+// Deletes the n tasks in ids in one transaction. Returns how many existed, or -1 on error
+// (nothing is deleted unless the caller's transaction carries on).
+int delete_tasks(TodoDb *db, const int *ids, size_t n)
+{
+    return run_for_ids(db, STMT_DELETE_TASK, ids, n, 0, 0);
+}
+
+// Sets the status of the n tasks in ids in one transaction; returns the count or -1.
+int set_status_bulk(TodoDb *db, const int *ids, size_t n, uint8_t status)
+{
+    return run_for_ids(db, STMT_SET_STATUS, ids, n, 1, status);
+}
+
+// One row of the TaskChanges journal, appended by triggers for every write to Tasks.
+typedef enum {
+    CHANGE_INSERT = 1,
+    CHANGE_UPDATE = 2,
+    CHANGE_DELETE = 3,
+} ChangeOp;
+
+typedef struct {
+    sqlite3_int64 seq;
+    int task_id;
+    uint8_t op;
+    sqlite3_int64 changed_at;   // unix time
+} TaskChange;
+
+// Fills changes with up to limit journal entries after seq, oldest first, and returns how
+// many there were. Pass the last seq seen to poll for more; 0 starts at the oldest kept.
+size_t changes_since(TodoDb *db, sqlite3_int64 seq, TaskChange *changes, size_t limit)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_CHANGES_SINCE);
+    size_t n = 0;
+    int rc;
+
+    if (!stmt) {
+        return n;
+    }
+    sqlite3_bind_int64(stmt, 1, seq);
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)limit);
+
+    while (n < limit && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        changes[n].seq = sqlite3_column_int64(stmt, 0);
+        changes[n].task_id = sqlite3_column_int(stmt, 1);
+        changes[n].op = (uint8_t)sqlite3_column_int(stmt, 2);
+        changes[n].changed_at = sqlite3_column_int64(stmt, 3);
+        n++;
+    }
+    if (n < limit && rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to read changes: %s\n", sqlite3_errmsg(db->conn));
+    }
+
+    release_stmt(stmt);
+    return n;
+}
+
+// Registers a consumer (new ones start at the current end of the log) and returns the seq
+// it has acknowledged up to, to resume changes_since from. Returns -1 on error.
+sqlite3_int64 register_consumer(TodoDb *db, const char *name)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_REGISTER_CONSUMER);
+    sqlite3_int64 seq = -1;
+
+    if (!stmt) {
+        return seq;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    int rc = sqlite3_step(stmt);
+    release_stmt(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Cannot register consumer: %s\n", sqlite3_errmsg(db->conn));
+        return -1;
+    }
+
+    stmt = acquire_stmt(db, STMT_SELECT_CONSUMER);
+    if (!stmt) {
+        return seq;
+    }
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        seq = sqlite3_column_int64(stmt, 0);
+    }
+    release_stmt(stmt);
+    return seq;
+}
+
+// Deletes the journal entries every consumer has acknowledged; returns how many or -1.
+int truncate_changes(TodoDb *db)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_TRUNCATE_CHANGES);
+    int deleted = -1;
+
+    if (!stmt) {
+        return deleted;
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        fprintf(stderr, "Cannot truncate changes: %s\n", sqlite3_errmsg(db->conn));
+    } else {
+        deleted = sqlite3_changes(db->conn);
+    }
+    release_stmt(stmt);
+    return deleted;
+}
+
+// Records that the consumer has processed everything up to seq, then drops the entries that
+// no consumer needs any more. Returns SQLITE_NOTFOUND for an unregistered consumer.
+int ack_changes(TodoDb *db, const char *name, sqlite3_int64 seq)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_ACK_CHANGES);
+    if (!stmt) {
+        return SQLITE_ERROR;
+    }
+
+    sqlite3_bind_int64(stmt, 1, seq);
+    sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
+    int rc = sqlite3_step(stmt);
+    release_stmt(stmt);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Cannot acknowledge changes: %s\n", sqlite3_errmsg(db->conn));
+        return rc;
+    }
+    if (sqlite3_changes(db->conn) == 0) {
+        fprintf(stderr, "No such consumer: %s\n", name);
+        return SQLITE_NOTFOUND;
+    }
+    return truncate_changes(db) < 0 ? SQLITE_ERROR : SQLITE_OK;
+}
+
+// Forgets a consumer so it no longer holds back truncation.
+int remove_consumer(TodoDb *db, const char *name)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_REMOVE_CONSUMER);
+    if (!stmt) {
+        return SQLITE_ERROR;
+    }
+
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    int rc = sqlite3_step(stmt);
+    release_stmt(stmt);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Cannot remove consumer: %s\n", sqlite3_errmsg(db->conn));
+        return rc;
+    }
+    return truncate_changes(db) < 0 ? SQLITE_ERROR : SQLITE_OK;
+}
+
+// ---- writer thread
+//
+// Producers on any thread queue mutations; one thread owns the connection and applies
+// whatever has queued up in a single transaction, so concurrent writers share each commit.
+
+typedef enum {
+    MUTATION_ADD,
+    MUTATION_EDIT,
+    MUTATION_DELETE,
+} MutationKind;
+
+typedef struct Mutation Mutation;
+typedef void (*MutationCallback)(const Mutation *mutation, void *arg);
+
+struct Mutation {
+    Mutation *next;
+    MutationKind kind;
+    int task_id;
+    Task task;                  // owns copies of its strings
+    MutationCallback callback;
+    void *arg;
+    sqlite3_int64 result;       // add: the new id; edit/delete: rows matched (0 or 1); -1 on error
+    atomic_int done;
+};
+
+typedef struct {
+    TodoDb *db;
+    _Atomic(Mutation *) queue;  // lock-free stack of submitted mutations, newest first
+    size_t max_batch;           // mutations per transaction, 0 = no limit
+    int window_us;              // how long a flush waits for more mutations to join it
+    pthread_t thread;
+    pthread_mutex_t lock;       // for sleeping and waking only; queuing never takes it
+    pthread_cond_t wake;        // to the writer: mutations arrived, or stopping
+    pthread_cond_t completed;   // to waiters: a flush finished
+    int stopping;
+    size_t flushes;
+    size_t mutations;
+} TaskWriter;
+
+void free_mutation(Mutation *mutation)
+{
+    if (mutation) {
+        free(mutation->task.name);
+        free((char *)mutation->task.category);
+        free(mutation->task.description);
+        free(mutation);
+    }
+}
+
+static Mutation *new_mutation(MutationKind kind, int task_id, const Task *task)
+{
+    Mutation *mutation = calloc(1, sizeof(Mutation));
+    if (!mutation) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+
+    mutation->kind = kind;
+    mutation->task_id = task_id;
+    if (task) {
+        mutation->task = *task;
+        mutation->task.name = task->name ? strdup(task->name) : NULL;
+        mutation->task.category = task->category ? strdup(task->category) : NULL;
+        mutation->task.description = task->description ? strdup(task->description) : NULL;
+        if ((task->name && !mutation->task.name) || (task->category && !mutation->task.category) ||
+            (task->description && !mutation->task.description)) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            free_mutation(mutation);
+            return NULL;
+        }
+    }
+    return mutation;
+}
+
+Mutation *add_mutation(const Task *task)
+{
+    return new_mutation(MUTATION_ADD, 0, task);
+}
+
+// Changes the fields set in changes, as edit_task does.
+Mutation *edit_mutation(int task_id, const Task *changes)
+{
+    return new_mutation(MUTATION_EDIT, task_id, changes);
+}
+
+Mutation *delete_mutation(int task_id)
+{
+    return new_mutation(MUTATION_DELETE, task_id, NULL);
+}
+
+// Queues a mutation for the writer thread. With a callback, the callback runs on the writer
+// thread once the mutation's transaction has committed (or failed) and the writer frees the
+// mutation afterwards. Without one, collect the result with wait_mutation.
+void submit_mutation(TaskWriter *writer, Mutation *mutation, MutationCallback callback, void *arg)
+{
+    mutation->callback = callback;
+    mutation->arg = arg;
+
+    Mutation *head = atomic_load_explicit(&writer->queue, memory_order_relaxed);
+    do {
+        mutation->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&writer->queue, &head, mutation,
+                                                    memory_order_release, memory_order_relaxed));
+
+    // Only the push onto an empty queue can find the writer asleep.
+    if (!head) {
+        pthread_mutex_lock(&writer->lock);
+        pthread_cond_signal(&writer->wake);
+        pthread_mutex_unlock(&writer->lock);
+    }
+}
+
+// Blocks until the mutation has been applied, frees it and returns its result.
+sqlite3_int64 wait_mutation(TaskWriter *writer, Mutation *mutation)
+{
+    pthread_mutex_lock(&writer->lock);
+    while (!atomic_load(&mutation->done)) {
+        pthread_cond_wait(&writer->completed, &writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    sqlite3_int64 result = mutation->result;
+    free_mutation(mutation);
+    return result;
+}
+
+// Moves everything queued onto the end of the writer's batch, oldest first.
+static size_t take_mutations(TaskWriter *writer, Mutation ***tail)
+{
+    Mutation *stack = atomic_exchange_explicit(&writer->queue, NULL, memory_order_acquire);
+    Mutation *list = NULL;
+    size_t n = 0;
+
+    while (stack) {
+        Mutation *next = stack->next;
+        stack->next = list;
+        list = stack;
+        stack = next;
+        n++;
+    }
+
+    **tail = list;
+    while (**tail) {
+        *tail = &(**tail)->next;
+    }
+    return n;
+}
+
+static sqlite3_int64 apply_mutation(TodoDb *db, Mutation *mutation)
+{
+    switch (mutation->kind) {
+    case MUTATION_ADD:
+        return insert_task(db, mutation->task);
+    case MUTATION_EDIT:
+        return update_task(db, mutation->task_id, &mutation->task);
+    case MUTATION_DELETE:
+        return remove_task(db, mutation->task_id);
+    }
+    return -1;
+}
+
+// Applies the first n mutations of the batch in one transaction, completes them and returns
+// the rest of the batch.
+static Mutation *flush_mutations(TaskWriter *writer, Mutation *batch, size_t n)
+{
+    TodoDb *db = writer->db;
+    int ok = run_stmt(db, STMT_BEGIN) == SQLITE_OK;
+    Mutation *mutation = batch;
+
+    for (size_t i = 0; i < n; i++, mutation = mutation->next) {
+        mutation->result = ok ? apply_mutation(db, mutation) : -1;
+    }
+    if (ok && run_stmt(db, STMT_COMMIT) != SQLITE_OK) {
+        run_stmt(db, STMT_ROLLBACK);
+        ok = 0;
+    }
+
+    Mutation *rest = mutation;
+    for (mutation = batch; mutation != rest;) {
+        Mutation *next = mutation->next;    // a waiter may free the mutation once it is done
+        if (!ok) {
+            mutation->result = -1;
+        }
+        if (mutation->callback) {
+            mutation->callback(mutation, mutation->arg);
+            free_mutation(mutation);
+        } else {
+            atomic_store(&mutation->done, 1);
+        }
+        mutation = next;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->flushes++;
+    writer->mutations += n;
+    pthread_cond_broadcast(&writer->completed);
+    pthread_mutex_unlock(&writer->lock);
+    return rest;
+}
+
+static void *task_writer_main(void *arg)
+{
+    TaskWriter *writer = arg;
+    Mutation *batch = NULL;
+    Mutation **tail = &batch;
+
+    for (;;) {
+        size_t n = take_mutations(writer, &tail);
+
+        if (n == 0) {
+            pthread_mutex_lock(&writer->lock);
+            while (!atomic_load(&writer->queue) && !writer->stopping) {
+                pthread_cond_wait(&writer->wake, &writer->lock);
+            }
+            int stop = writer->stopping && !atomic_load(&writer->queue);
+            pthread_mutex_unlock(&writer->lock);
+            if (stop) {
+                break;
+            }
+            continue;
+        }
+
+        // Hold the transaction open a little longer so more producers can join it.
+        if (writer->window_us > 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += writer->window_us * 1000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+
+            pthread_mutex_lock(&writer->lock);
+            while ((!writer->max_batch || n < writer->max_batch) && !writer->stopping) {
+                if (!atomic_load(&writer->queue) &&
+                    pthread_cond_timedwait(&writer->wake, &writer->lock, &deadline) != 0) {
+                    break;
+                }
+                pthread_mutex_unlock(&writer->lock);
+                n += take_mutations(writer, &tail);
+                pthread_mutex_lock(&writer->lock);
+            }
+            pthread_mutex_unlock(&writer->lock);
+        }
+
+        while (n > 0) {
+            size_t chunk = writer->max_batch && n > writer->max_batch ? writer->max_batch : n;
+            batch = flush_mutations(writer, batch, chunk);
+            n -= chunk;
+        }
+        tail = &batch;
+    }
+    return NULL;
+}
+
+// Starts a thread that owns db until stop_task_writer: nothing else may use the connection
+// meanwhile. Each flush commits at most max_batch mutations (0 = all queued) and waits up to
+// window_us for more to arrive before committing.
+TaskWriter *start_task_writer(TodoDb *db, size_t max_batch, int window_us)
+{
+    TaskWriter *writer = calloc(1, sizeof(TaskWriter));
+    if (!writer) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+
+    writer->db = db;
+    writer->max_batch = max_batch;
+    writer->window_us = window_us;
+    atomic_init(&writer->queue, NULL);
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->wake, NULL);
+    pthread_cond_init(&writer->completed, NULL);
+
+    if (pthread_create(&writer->thread, NULL, task_writer_main, writer) != 0) {
+        fprintf(stderr, "Cannot start writer thread\n");
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->wake);
+        pthread_cond_destroy(&writer->completed);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+// Applies everything still queued, then stops the thread and hands the connection back.
+void stop_task_writer(TaskWriter *writer)
+{
+    if (!writer) {
+        return;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->stopping = 1;
+    pthread_cond_signal(&writer->wake);
+    pthread_mutex_unlock(&writer->lock);
+
+    pthread_join(writer->thread, NULL);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->wake);
+    pthread_cond_destroy(&writer->completed);
+    free(writer);
+}
+
+// Bump allocator for the strings of one TaskList: a fetch copies every name and description
+// into a few large chunks, and freeing the list releases them chunk by chunk.
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk *head;
+    size_t num_chunks;
+} Arena;
+
+// Packs allocations end to end with no padding, so on its own it is only for strings.
+static void *arena_alloc(Arena *arena, size_t n)
+{
+    ArenaChunk *chunk = arena->head;
+
+    if (!chunk || chunk->size - chunk->used < n) {
+        size_t size = n > ARENA_CHUNK_SIZE ? n : ARENA_CHUNK_SIZE;
+        chunk = malloc(sizeof(ArenaChunk) + size);
+        if (!chunk) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            return NULL;
+        }
+        chunk->used = 0;
+        chunk->size = size;
+        chunk->next = arena->head;
+        arena->head = chunk;
+        arena->num_chunks++;
+    }
+
+    void *p = chunk->data + chunk->used;
+    chunk->used += n;
+    return p;
+}
+
+// An arena allocation aligned for any type, for pointer tables and the like.
+static void *arena_alloc_aligned(Arena *arena, size_t n)
+{
+    size_t align = _Alignof(max_align_t);
+    char *p = arena_alloc(arena, n + align - 1);
+    return p ? p + (-(uintptr_t)p & (align - 1)) : NULL;
+}
+
+static char *arena_strdup(Arena *arena, const char *text)
+{
+    if (!text) {
+        return NULL;
+    }
+
+    size_t n = strlen(text) + 1;
+    char *copy = arena_alloc(arena, n);
+    if (copy) {
+        memcpy(copy, text, n);
+    }
+    return copy;
+}
+
+static void arena_free(Arena *arena)
+{
+    ArenaChunk *chunk = arena->head;
+
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->num_chunks = 0;
+}
+
+// Tasks in a list share the list's arena; release them all at once with free_tasklist.
+typedef struct {
+    Task *tasks;
+    size_t count;
+    size_t capacity;
+    Arena arena;
+} TaskList;
+
+// Appends a copy of a (possibly borrowed) task, its strings going into the list's arena.
+static int append_task(TaskList *tasklist, const Task *task)
+{
+    if (tasklist->count >= tasklist->capacity) {
+        size_t capacity = tasklist->capacity ? tasklist->capacity * 2 : 64;
+        Task *temp = realloc(tasklist->tasks, capacity * sizeof(Task));
+        if (!temp) {
+            fprintf(stderr, "Failed to realloc memory\n");
+            return -1;
+        }
+        tasklist->tasks = temp;
+        tasklist->capacity = capacity;
+    }
+
+    Task *copy = &tasklist->tasks[tasklist->count++];
+    *copy = *task;
+    copy->name = arena_strdup(&tasklist->arena, task->name);
+    copy->description = arena_strdup(&tasklist->arena, task->description);
+    if ((task->name && !copy->name) || (task->description && !copy->description)) {
+        tasklist->count--;
+        return -1;
+    }
+    return 0;
+}
+
+// Drains a cursor into tasklist and closes it.
+static void collect_cursor(TaskCursor *cursor, TaskList *tasklist)
+{
+    const Task *task;
+
+    while ((task = task_cursor_next(cursor))) {
+        if (append_task(tasklist, task) < 0) {
+            break;
+        }
+    }
+    task_cursor_close(cursor);
+}
+
+// Appends every remaining row of a cached "SELECT Id, Name, ..." statement, then releases it.
+static void collect_into(TodoDb *db, sqlite3_stmt *stmt, TaskList *tasklist)
+{
+    TaskCursor cursor;
+
+    task_cursor_wrap(&cursor, db, stmt, 0);
+    collect_cursor(&cursor, tasklist);
+}
+
+static TaskList collect_tasks(TodoDb *db, sqlite3_stmt *stmt)
+{
+    TaskList tasklist = {0};
+
+    collect_into(db, stmt, &tasklist);
+    return tasklist;
+}
+
+TaskList fetch_tasks(TodoDb *db) {
+    TaskList tasklist = {0};
+    TaskCursor cursor;
+
+    if (task_cursor_open(db, &cursor) == SQLITE_OK) {
+        collect_cursor(&cursor, &tasklist);
+    }
+    return tasklist;
+}
+
+static int filter_shape(const TaskFilter *filter)
+{
+    return (filter->category ? FILTER_CATEGORY : 0) |
+           (filter->status ? FILTER_STATUS : 0) |
+           (filter->priority ? FILTER_PRIORITY : 0) |
+           (filter->open_only ? FILTER_OPEN : 0) |
+           (filter->due_from ? FILTER_DUE_FROM : 0) |
+           (filter->due_to ? FILTER_DUE_TO : 0) |
+           (filter->completed_before ? FILTER_COMPLETED_BEFORE : 0);
+}
+
+// Returns the cached statement for this operation and filter shape with its parameters bound.
+static sqlite3_stmt *prepare_filter_stmt(TodoDb *db, int op, const TaskFilter *filter)
+{
+    static const char *op_sql[NUM_OF_FILTER_OPS][2] = {
+        [FILTER_SELECT] = {"SELECT Id, Name, CategoryId, StartDate, DueDate, CompletionDate, Status, Priority, Description "
+                           "FROM Tasks WHERE 1", " ORDER BY DueDate, Id;"},
+        [FILTER_DELETE] = {"DELETE FROM Tasks WHERE 1", ";"},
+        [FILTER_SET_STATUS] = {"UPDATE Tasks SET Status = :new_status WHERE 1", ";"},
+    };
+    int shape = filter_shape(filter);
+    sqlite3_stmt *stmt = db->filter_stmts[op][shape];
+
+    if (!stmt) {
+        char sql[512];
+
+        snprintf(sql, sizeof(sql), "%s%s%s%s%s%s%s%s%s", op_sql[op][0],
+                 shape & FILTER_CATEGORY ?  " AND CategoryId = :category" : "",
+                 shape & FILTER_STATUS ? " AND Status = :status" : "",
+                 shape & FILTER_PRIORITY ? " AND Priority = :priority" : "",
+                 shape & FILTER_OPEN ? " AND CompletionDate IS NULL" : "",
+                 shape & FILTER_DUE_FROM ? " AND DueDate >= :due_from" : "",
+                 shape & FILTER_DUE_TO ? " AND DueDate <= :due_to" : "",
+                 shape & FILTER_COMPLETED_BEFORE ? " AND CompletionDate < :completed_before" : "",
+                 op_sql[op][1]);
+
+        if (sqlite3_prepare_v3(db->conn, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db->conn));
+            return NULL;
+        }
+        db->filter_stmts[op][shape] = stmt;
+    }
+
+    if (filter->category) {
+        // An unknown category can't match anything; -1 keeps the statement shape the same.
+        int id = category_id(db, filter->category, 0);
+        sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":category"), id ? id : -1);
+    }
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":status"), filter->status);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":priority"), filter->priority);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":due_from"), filter->due_from);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":due_to"), filter->due_to);
+    sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, ":completed_before"), filter->completed_before);
+    return stmt;
+}
+
+// Tasks matching every field set in filter (NULL/0 fields are ignored), ordered by due date.
+TaskList fetch_tasks_where(TodoDb *db, const TaskFilter *filter)
+{
+    TaskList tasklist = {0};
+    sqlite3_stmt *stmt = prepare_filter_stmt(db, FILTER_SELECT, filter);
+
+    if (stmt) {
+        tasklist = collect_tasks(db, stmt);
+    }
+    return tasklist;
+}
+
+static int run_filter_stmt(TodoDb *db, sqlite3_stmt *stmt)
+{
+    int affected = -1;
+
+    if (!stmt) {
+        return -1;
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db->conn));
+    } else {
+        affected = sqlite3_changes(db->conn);
+    }
+    release_stmt(stmt);
+    return affected;
+}
+
+// Deletes every task matching filter in one statement, e.g. Done tasks completed before a
+// day with {.status = STATUS_DONE, .completed_before = day}. Returns the count or -1.
+int delete_tasks_where(TodoDb *db, const TaskFilter *filter)
+{
+    if (!filter_shape(filter)) {
+        fprintf(stderr, "Refusing to delete with an empty filter\n");
+        return -1;
+    }
+    return run_filter_stmt(db, prepare_filter_stmt(db, FILTER_DELETE, filter));
+}
+
+int set_status_where(TodoDb *db, const TaskFilter *filter, uint8_t status)
+{
+    sqlite3_stmt *stmt = prepare_filter_stmt(db, FILTER_SET_STATUS, filter);
+
+    if (stmt) {
+        bind_code(stmt, sqlite3_bind_parameter_index(stmt, ":new_status"), status);
+    }
+    return run_filter_stmt(db, stmt);
+}
+
+// Prints the query plan of stmt; returns 1 if any step scans the whole table or sorts.
+static int explain_stmt(TodoDb *db, sqlite3_stmt *stmt)
+{
+    sqlite3_stmt *plan;
+    char *sql;
+    int full_scan = 0;
+
+    if (!stmt) {
+        return 1;
+    }
+    sql = sqlite3_mprintf("EXPLAIN QUERY PLAN %s", sqlite3_sql(stmt));
+    if (sqlite3_prepare_v2(db->conn, sql, -1, &plan, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db->conn));
+        sqlite3_free(sql);
+        return 1;
+    }
+    sqlite3_free(sql);
+
+    while (sqlite3_step(plan) == SQLITE_ROW) {
+        const char *detail = get_column_text(plan, 3);
+        printf("    %s\n", detail);
+        if (strcmp(detail, "SCAN Tasks") == 0 || strstr(detail, "TEMP B-TREE")) {
+            full_scan = 1;
+        }
+    }
+
+    sqlite3_finalize(plan);
+    return full_scan;
+}
+
+int explain_tasks_where(TodoDb *db, int op, const TaskFilter *filter)
+{
+    sqlite3_stmt *stmt = prepare_filter_stmt(db, op, filter);
+    if (!stmt) {
+        return 1;
+    }
+
+    release_stmt(stmt);
+    return explain_stmt(db, stmt);
+}
+
+typedef enum {
+    TASK_SORT_ID,
+    TASK_SORT_DUE_DATE,         // dated tasks by (DueDate, Id), then undated ones by Id
+} TaskSort;
+
+// Where the previous page ended. A zeroed key starts at the first page.
+typedef struct {
+    int id;
+    int due_date;
+    int undated;                // TASK_SORT_DUE_DATE: past the last dated task
+} TaskPageKey;
+
+typedef struct {
+    TaskList list;
+    TaskPageKey next;           // pass back in to get the following page
+    int has_more;
+} TaskPage;
+
+static void page_key_after(TaskPageKey *key, const Task *task)
+{
+    key->id = task->id;
+    key->due_date = task->due_date;
+    key->undated = task->due_date == 0;
+}
+
+// Runs one keyset range query for up to limit rows and appends them to the page.
+static void fetch_page_range(TodoDb *db, int which, const TaskPageKey *after, int limit, TaskPage *page)
+{
+    sqlite3_stmt *stmt = acquire_stmt(db, which);
+
+    if (!stmt) {
+        return;
+    }
+    if (which == STMT_PAGE_BY_DUE_DATE) {
+        sqlite3_bind_int(stmt, 1, after->due_date);
+        sqlite3_bind_int(stmt, 2, after->id);
+        sqlite3_bind_int(stmt, 3, limit);
+    } else {
+        sqlite3_bind_int(stmt, 1, after->id);
+        sqlite3_bind_int(stmt, 2, limit);
+    }
+
+    collect_into(db, stmt, &page->list);
+}
+
+// Up to limit tasks following after (NULL for the first page) in the given order.
+// Each page is an index seek from the previous key, so deep pages cost the same as the first.
+TaskPage fetch_tasks_page(TodoDb *db, const TaskPageKey *after, int limit, TaskSort sort)
+{
+    TaskPage page = {0};
+    TaskPageKey start = {0};
+    // One extra row tells us whether another page follows.
+    int want = limit + 1;
+
+    if (after) {
+        start = *after;
+    }
+
+    if (sort == TASK_SORT_ID) {
+        fetch_page_range(db, STMT_PAGE_BY_ID, &start, want, &page);
+    } else {
+        if (!start.undated) {
+            fetch_page_range(db, STMT_PAGE_BY_DUE_DATE, &start, want, &page);
+            if ((int)page.list.count < want) {
+                start.id = 0;
+            }
+        }
+        if ((int)page.list.count < want) {
+            fetch_page_range(db, STMT_PAGE_UNDATED, &start, want - (int)page.list.count, &page);
+        }
+    }
+
+    if ((int)page.list.count > limit) {
+        page.list.count--;
+        page.has_more = 1;
+    }
+    if (page.list.count > 0) {
+        page_key_after(&page.next, &page.list.tasks[page.list.count - 1]);
+    } else {
+        page.next = start;
+    }
+    return page;
+}
+
+void free_tasklist(TaskList *tasklist)
+{
+    arena_free(&tasklist->arena);
+    free(tasklist->tasks);
+    tasklist->tasks = NULL;
+    tasklist->count = tasklist->capacity = 0;
+}
+
+// Ranked full-text matches: snippets[i] is the best fragment of tasks[i] with the matched
+// terms between SNIPPET_OPEN and SNIPPET_CLOSE. Snippets live in the list's arena.
+typedef struct {
+    TaskList list;
+    const char **snippets;
+    double *ranks;              // bm25, lower is better
+} TaskMatches;
+
+// Best limit matches for an FTS5 query ("plan*", "\"weekly report\"", "name:tax OR bills").
+// On a malformed query or a limit below 1 the error is printed and no matches are returned.
+TaskMatches search_tasks(TodoDb *db, const char *query, int limit)
+{
+    TaskMatches matches = {0};
+    TaskCursor cursor;
+    const Task *task;
+
+    if (limit <= 0) {
+        fprintf(stderr, "Search limit must be positive, got %d\n", limit);
+        return matches;
+    }
+    matches.snippets = malloc(limit * sizeof(*matches.snippets));
+    matches.ranks = malloc(limit * sizeof(*matches.ranks));
+    if (!matches.snippets || !matches.ranks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return matches;
+    }
+
+    sqlite3_stmt *stmt = acquire_stmt(db, STMT_SEARCH_TASKS);
+    if (!stmt) {
+        return matches;
+    }
+    sqlite3_bind_text(stmt, 1, query, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, limit);
+
+    task_cursor_wrap(&cursor, db, stmt, 0);
+    while ((task = task_cursor_next(&cursor))) {
+        size_t i = matches.list.count;
+        if (append_task(&matches.list, task) < 0) {
+            break;
+        }
+        const char *snippet = get_column_text(stmt, 9);
+        matches.snippets[i] = arena_strdup(&matches.list.arena, snippet);
+        if (snippet && !matches.snippets[i]) {
+            matches.list.count--;
+            break;
+        }
+        matches.ranks[i] = sqlite3_column_double(stmt, 10);
+    }
+    task_cursor_close(&cursor);
+    return matches;
+}
+
+void free_task_matches(TaskMatches *matches)
+{
+    free_tasklist(&matches->list);
+    free(matches->snippets);
+    free(matches->ranks);
+    matches->snippets = NULL;
+    matches->ranks = NULL;
+}
+
+// Rebuilds the full-text index from Tasks, e.g. after editing the table by hand.
+int rebuild_search_index(TodoDb *db)
+{
+    char *err = NULL;
+
+    if (sqlite3_exec(db->conn, "INSERT INTO TasksFts(TasksFts) VALUES ('rebuild');", NULL, NULL, &err) != SQLITE_OK) {
+        fprintf(stderr, "Cannot rebuild search index: %s\n", err);
+        sqlite3_free(err);
+        return SQLITE_ERROR;
+    }
+    return SQLITE_OK;
+}
+
+// One incremental step of merging the index's segments, writing about pages pages. Returns
+// 1 if there was work to do (call again), 0 once the index is merged, -1 on error.
+int merge_search_index(TodoDb *db, int pages)
+{
+    sqlite3_stmt *stmt;
+    int before = sqlite3_total_changes(db->conn);
+    int rc;
+
+    if (sqlite3_prepare_v2(db->conn, "INSERT INTO TasksFts(TasksFts, rank) VALUES ('merge', ?);", -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db->conn));
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, pages);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Cannot merge search index: %s\n", sqlite3_errmsg(db->conn));
+        return -1;
+    }
+    return sqlite3_total_changes(db->conn) - before > 1;
+}
+
+// ---- async API
+//
+// Reads run on worker threads over pooled read-only connections and writes go through a
+// TaskWriter, so nothing here blocks the caller on disk I/O. Results wait in a completion
+// queue until the main loop calls drain_completions, which runs the callbacks on its thread.
+
+// Everything a fetch or search result points to lives in its list's arena, categories
+// included, so it stays valid after stop_async and goes wherever the list is moved.
+typedef struct {
+    sqlite3_int64 value;        // add: the new id; edit/delete: rows matched; -1 on error
+    TaskList tasks;             // fetches
+    TaskMatches matches;        // searches
+    const char **status_names;  // fetches and searches: MAX_CODES names by code, NULL if unset
+    const char **priority_names;
+} TodoResult;
+
+// Runs inside drain_completions. The result is freed afterwards; to keep the tasks or
+// matches, move them out and zero the field.
+typedef void (*TodoCallback)(TodoResult *result, void *arg);
+
+typedef enum {
+    ASYNC_MUTATION,
+    ASYNC_FETCH,
+    ASYNC_FETCH_WHERE,
+    ASYNC_SEARCH,
+} AsyncKind;
+
+typedef struct AsyncJob {
+    struct AsyncJob *next;
+    struct TodoAsync *owner;
+    AsyncKind kind;
+    TaskFilter filter;          // its category is an owned copy
+    char *query;
+    int limit;
+    TodoCallback callback;
+    void *arg;
+    TodoResult result;
+} AsyncJob;
+
+typedef struct TodoAsync {
+    TodoPool *pool;
+    TaskWriter *writer;         // owns the pool's writer connection
+    pthread_t *workers;
+    int num_workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    AsyncJob *jobs;             // FIFO of reads for the workers
+    AsyncJob **jobs_tail;
+    int stopping;
+    pthread_mutex_t completed_lock;
+    AsyncJob *completed;        // FIFO of finished jobs for drain_completions
+    AsyncJob **completed_tail;
+} TodoAsync;
+
+static void free_async_job(AsyncJob *job)
+{
+    free((char *)job->filter.category);
+    free(job->query);
+    free_tasklist(&job->result.tasks);
+    free_task_matches(&job->result.matches);
+    free(job);
+}
+
+static void complete_async_job(TodoAsync *async, AsyncJob *job)
+{
+    job->next = NULL;
+    pthread_mutex_lock(&async->completed_lock);
+    *async->completed_tail = job;
+    async->completed_tail = &job->next;
+    pthread_mutex_unlock(&async->completed_lock);
+}
+
+static const char **copy_code_names(Arena *arena, char *const names[MAX_CODES])
+{
+    const char **copy = arena_alloc_aligned(arena, MAX_CODES * sizeof(const char *));
+    if (!copy) {
+        return NULL;
+    }
+    for (int i = 0; i < MAX_CODES; i++) {
+        copy[i] = arena_strdup(arena, names[i]);
+    }
+    return copy;
+}
+
+// Moves what a list borrows from the reader connection into its own arena: categories
+// are interned in the reader's CategoryPool, which close_pool frees, and the callback
+// has no connection to look status and priority codes up with.
+static void detach_from_reader(TodoDb *db, TaskList *tasklist, TodoResult *result)
+{
+    const char **categories = NULL;
+    int num_categories = 0;
+
+    for (size_t i = 0; i < tasklist->count; i++) {
+        Task *task = &tasklist->tasks[i];
+        int id = task->category_id;
+        if (!task->category || id <= 0) {
+            continue;
+        }
+        if (id >= num_categories) {
+            int count = id * 2;
+            const char **temp = realloc(categories, count * sizeof(const char *));
+            if (!temp) {
+                fprintf(stderr, "Failed to realloc memory\n");
+                task->category = NULL;
+                continue;
+            }
+            memset(temp + num_categories, 0, (count - num_categories) * sizeof(const char *));
+            categories = temp;
+            num_categories = count;
+        }
+        if (!categories[id]) {
+            categories[id] = arena_strdup(&tasklist->arena, task->category);
+        }
+        task->category = categories[id];
+    }
+    free(categories);
+
+    result->status_names = copy_code_names(&tasklist->arena, db->status_names);
+    result->priority_names = copy_code_names(&tasklist->arena, db->priority_names);
+}
+
+static void run_async_job(TodoDb *db, AsyncJob *job)
+{
+    switch (job->kind) {
+    case ASYNC_FETCH:
+        job->result.tasks = fetch_tasks(db);
+        detach_from_reader(db, &job->result.tasks, &job->result);
+        break;
+    case ASYNC_FETCH_WHERE:
+        job->result.tasks = fetch_tasks_where(db, &job->filter);
+        detach_from_reader(db, &job->result.tasks, &job->result);
+        break;
+    case ASYNC_SEARCH:
+        job->result.matches = search_tasks(db, job->query, job->limit);
+        detach_from_reader(db, &job->result.matches.list, &job->result);
+        break;
+    case ASYNC_MUTATION:
+        break;
+    }
+}
+
+static void *async_worker_main(void *arg)
+{
+    TodoAsync *async = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&async->lock);
+        while (!async->jobs && !async->stopping) {
+            pthread_cond_wait(&async->work, &async->lock);
+        }
+        AsyncJob *job = async->jobs;
+        if (job) {
+            async->jobs = job->next;
+            if (!async->jobs) {
+                async->jobs_tail = &async->jobs;
+            }
+        }
+        pthread_mutex_unlock(&async->lock);
+
+        if (!job) {
+            break;
+        }
+
+        TodoDb *reader = acquire_reader(async->pool);
+        run_async_job(reader, job);
+        release_reader(async->pool, reader);
+        complete_async_job(async, job);
+    }
+    return NULL;
+}
+
+void stop_async(TodoAsync *async)
+{
+    if (!async) {
+        return;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    async->stopping = 1;
+    pthread_cond_broadcast(&async->work);
+    pthread_mutex_unlock(&async->lock);
+
+    for (int i = 0; i < async->num_workers; i++) {
+        pthread_join(async->workers[i], NULL);
+    }
+    if (async->writer) {
+        stop_task_writer(async->writer);
+        release_writer(async->pool);
+    }
+
+    // Results nobody drained.
+    while (async->completed) {
+        AsyncJob *next = async->completed->next;
+        free_async_job(async->completed);
+        async->completed = next;
+    }
+
+    close_pool(async->pool);
+    pthread_mutex_destroy(&async->lock);
+    pthread_cond_destroy(&async->work);
+    pthread_mutex_destroy(&async->completed_lock);
+    free(async->workers);
+    free(async);
+}
+
+// Opens the database for num_workers concurrent reads plus one writer thread.
+TodoAsync *start_async(const char *path, const StorageProfile *profile, int num_workers)
+{
+    TodoAsync *async = calloc(1, sizeof(TodoAsync));
+    if (!async) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->work, NULL);
+    pthread_mutex_init(&async->completed_lock, NULL);
+    async->jobs_tail = &async->jobs;
+    async->completed_tail = &async->completed;
+
+    async->pool = open_pool(path, profile, num_workers);
+    async->workers = calloc(num_workers, sizeof(pthread_t));
+    if (!async->pool || !async->workers) {
+        stop_async(async);
+        return NULL;
+    }
+
+    async->writer = start_task_writer(acquire_writer(async->pool), 0, 0);
+    if (!async->writer) {
+        release_writer(async->pool);
+        stop_async(async);
+        return NULL;
+    }
+
+    for (; async->num_workers < num_workers; async->num_workers++) {
+        if (pthread_create(&async->workers[async->num_workers], NULL, async_worker_main, async) != 0) {
+            fprintf(stderr, "Cannot start worker thread\n");
+            stop_async(async);
+            return NULL;
+        }
+    }
+    return async;
+}
+
+static AsyncJob *new_async_job(TodoAsync *async, AsyncKind kind, TodoCallback callback, void *arg)
+{
+    AsyncJob *job = calloc(1, sizeof(AsyncJob));
+    if (!job) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return NULL;
+    }
+    job->owner = async;
+    job->kind = kind;
+    job->callback = callback;
+    job->arg = arg;
+    return job;
+}
+
+static int queue_async_job(TodoAsync *async, AsyncJob *job)
+{
+    if (!job) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&async->lock);
+    *async->jobs_tail = job;
+    async->jobs_tail = &job->next;
+    pthread_cond_signal(&async->work);
+    pthread_mutex_unlock(&async->lock);
+    return 0;
+}
+
+static void mutation_done(const Mutation *mutation, void *arg)
+{
+    AsyncJob *job = arg;
+
+    job->result.value = mutation->result;
+    complete_async_job(job->owner, job);
+}
+
+static int submit_async_mutation(TodoAsync *async, Mutation *mutation, TodoCallback callback, void *arg)
+{
+    AsyncJob *job = mutation ? new_async_job(async, ASYNC_MUTATION, callback, arg) : NULL;
+    if (!job) {
+        free_mutation(mutation);
+        return -1;
+    }
+    submit_mutation(async->writer, mutation, mutation_done, job);
+    return 0;
+}
+
+// Each of these returns 0 once the request is queued, or -1 if it couldn't be (and the
+// callback won't run). Strings are copied, so the arguments needn't outlive the call.
+int add_task_async(TodoAsync *async, const Task *task, TodoCallback callback, void *arg)
+{
+    return submit_async_mutation(async, add_mutation(task), callback, arg);
+}
+
+int edit_task_async(TodoAsync *async, int task_id, const Task *changes, TodoCallback callback, void *arg)
+{
+    return submit_async_mutation(async, edit_mutation(task_id, changes), callback, arg);
+}
+
+int delete_task_async(TodoAsync *async, int task_id, TodoCallback callback, void *arg)
+{
+    return submit_async_mutation(async, delete_mutation(task_id), callback, arg);
+}
+
+int fetch_tasks_async(TodoAsync *async, TodoCallback callback, void *arg)
+{
+    return queue_async_job(async, new_async_job(async, ASYNC_FETCH, callback, arg));
+}
+
+int fetch_tasks_where_async(TodoAsync *async, const TaskFilter *filter, TodoCallback callback, void *arg)
+{
+    AsyncJob *job = new_async_job(async, ASYNC_FETCH_WHERE, callback, arg);
+    if (job) {
+        job->filter = *filter;
+        job->filter.category = filter->category ? strdup(filter->category) : NULL;
+    }
+    return queue_async_job(async, job);
+}
+
+int search_tasks_async(TodoAsync *async, const char *query, int limit, TodoCallback callback, void *arg)
+{
+    AsyncJob *job = new_async_job(async, ASYNC_SEARCH, callback, arg);
+    if (job) {
+        job->query = strdup(query);
+        job->limit = limit;
+    }
+    return queue_async_job(async, job);
+}
+
+// Runs the callbacks of up to max finished requests (0 = all of them) on the calling thread,
+// in completion order, and returns how many ran. Meant to be called once per frame.
+size_t drain_completions(TodoAsync *async, size_t max)
+{
+    pthread_mutex_lock(&async->completed_lock);
+    AsyncJob *jobs = async->completed;
+    AsyncJob *last = NULL;
+    size_t n = 0;
+
+    for (AsyncJob *job = jobs; job && (!max || n < max); job = job->next) {
+        last = job;
+        n++;
+    }
+    if (last) {
+        async->completed = last->next;
+        if (!async->completed) {
+            async->completed_tail = &async->completed;
+        }
+        last->next = NULL;
+    }
+    pthread_mutex_unlock(&async->completed_lock);
+
+    while (jobs) {
+        AsyncJob *next = jobs->next;
+        if (jobs->callback) {
+            jobs->callback(&jobs->result, jobs->arg);
+        }
+        free_async_job(jobs);
+        jobs = next;
+    }
+    return n;
+}
+
+// Struct-of-arrays copy of the task table for dashboards and reports that scan a few
+// fields across every task. Strings live in one heap addressed by offset.
+#define NO_STRING UINT32_MAX
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    int32_t *ids;
+    int32_t *due_dates;
+    int32_t *completion_dates;
+    uint8_t *statuses;
+    uint8_t *priorities;
+    int32_t *category_ids;
+    uint32_t *name_offsets;         // into strings, NO_STRING for NULL
+    uint32_t *description_offsets;
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+} TaskColumns;
+
+void free_task_columns(TaskColumns *columns)
+{
+    free(columns->ids);
+    free(columns->due_dates);
+    free(columns->completion_dates);
+    free(columns->statuses);
+    free(columns->priorities);
+    free(columns->category_ids);
+    free(columns->name_offsets);
+    free(columns->description_offsets);
+    free(columns->strings);
+    memset(columns, 0, sizeof(*columns));
+}
+
+static int grow_column(void **column, size_t capacity, size_t width)
+{
+    void *temp = realloc(*column, capacity * width);
+    if (!temp) {
+        return -1;
+    }
+    *column = temp;
+    return 0;
+}
+
+static int task_columns_reserve(TaskColumns *columns, size_t capacity)
+{
+    if (grow_column((void **)&columns->ids, capacity, sizeof(int32_t)) < 0 ||
+        grow_column((void **)&columns->due_dates, capacity, sizeof(int32_t)) < 0 ||
+        grow_column((void **)&columns->completion_dates, capacity, sizeof(int32_t)) < 0 ||
+        grow_column((void **)&columns->statuses, capacity, sizeof(uint8_t)) < 0 ||
+        grow_column((void **)&columns->priorities, capacity, sizeof(uint8_t)) < 0 ||
+        grow_column((void **)&columns->category_ids, capacity, sizeof(int32_t)) < 0 ||
+        grow_column((void **)&columns->name_offsets, capacity, sizeof(uint32_t)) < 0 ||
+        grow_column((void **)&columns->description_offsets, capacity, sizeof(uint32_t)) < 0) {
+        fprintf(stderr, "Failed to realloc memory\n");
+        return -1;
+    }
+    columns->capacity = capacity;
+    return 0;
+}
+
+static uint32_t task_columns_add_string(TaskColumns *columns, const char *text)
+{
+    if (!text) {
+        return NO_STRING;
+    }
+
+    size_t n = strlen(text) + 1;
+    if (columns->strings_size + n > columns->strings_capacity) {
+        size_t capacity = columns->strings_capacity ? columns->strings_capacity : ARENA_CHUNK_SIZE;
+        while (columns->strings_size + n > capacity) {
+            capacity *= 2;
+        }
+        if (capacity > NO_STRING || grow_column((void **)&columns->strings, capacity, 1) < 0) {
+            fprintf(stderr, "Failed to realloc memory\n");
+            return NO_STRING;
+        }
+        columns->strings_capacity = capacity;
+    }
+
+    uint32_t offset = (uint32_t)columns->strings_size;
+    memcpy(columns->strings + offset, text, n);
+    columns->strings_size += n;
+    return offset;
+}
+
+// Loads every task into columns (which must be zeroed or freed).
+int load_task_columns(TodoDb *db, TaskColumns *columns)
+{
+    TaskCursor cursor;
+    const Task *task;
+
+    if (task_cursor_open(db, &cursor) != SQLITE_OK) {
+        return SQLITE_ERROR;
+    }
+
+    while ((task = task_cursor_next(&cursor))) {
+        size_t row = columns->count;
+        if (row >= columns->capacity && task_columns_reserve(columns, columns->capacity ? columns->capacity * 2 : 1024) < 0) {
+            task_cursor_close(&cursor);
+            return SQLITE_NOMEM;
+        }
+
+        columns->ids[row] = task->id;
+        columns->due_dates[row] = task->due_date;
+        columns->completion_dates[row] = task->completion_date;
+        columns->statuses[row] = task->status;
+        columns->priorities[row] = task->priority;
+        columns->category_ids[row] = task->category_id;
+        columns->name_offsets[row] = task_columns_add_string(columns, task->name);
+        columns->description_offsets[row] = task_columns_add_string(columns, task->description);
+        columns->count++;
+    }
+
+    task_cursor_close(&cursor);
+    return SQLITE_OK;
+}
+
+const char *task_columns_name(const TaskColumns *columns, size_t row)
+{
+    uint32_t offset = columns->name_offsets[row];
+    return offset == NO_STRING ? NULL : columns->strings + offset;
+}
+
+const char *task_columns_description(const TaskColumns *columns, size_t row)
+{
+    uint32_t offset = columns->description_offsets[row];
+    return offset == NO_STRING ? NULL : columns->strings + offset;
+}
+
+// The kernels below are branch-free over plain arrays so the compiler can vectorize them.
+
+size_t count_due_between(const TaskColumns *columns, int from, int to)
+{
+    const int32_t *due = columns->due_dates;
+    size_t n = 0;
+
+    for (size_t i = 0; i < columns->count; i++) {
+        n += (due[i] >= from) & (due[i] <= to);
+    }
+    return n;
+}
+
+// Open tasks with a due date before day.
+size_t count_overdue(const TaskColumns *columns, int day)
+{
+    const int32_t *due = columns->due_dates;
+    const int32_t *completed = columns->completion_dates;
+    size_t n = 0;
+
+    for (size_t i = 0; i < columns->count; i++) {
+        n += (completed[i] == 0) & (due[i] > 0) & (due[i] < day);
+    }
+    return n;
+}
+
+void count_by_status(const TaskColumns *columns, size_t counts[MAX_CODES])
+{
+    memset(counts, 0, MAX_CODES * sizeof(size_t));
+    for (size_t i = 0; i < columns->count; i++) {
+        counts[columns->statuses[i]]++;
+    }
+}
+
+// Writes the rows matching filter to rows (room for columns->count entries) and returns how
+// many there are. Only the columnar fields are checked: category_id (by name is resolved by
+// the caller), status, priority, open_only, the due range and completed_before. Matches
+// fetch_tasks_where: a date bound, like SQL's comparison with NULL, excludes undated tasks.
+size_t filter_task_columns(const TaskColumns *columns, const TaskFilter *filter, int category_id, uint32_t *rows)
+{
+    int dated = filter->due_from || filter->due_to;
+    int32_t due_from = filter->due_from ? filter->due_from : dated ? 1 : INT32_MIN;
+    int32_t due_to = filter->due_to ? filter->due_to : INT32_MAX;
+    int32_t completed_from = filter->completed_before ? 1 : INT32_MIN;
+    int32_t completed_to = filter->completed_before ? filter->completed_before - 1 : INT32_MAX;
+    size_t n = 0;
+
+    for (size_t i = 0; i < columns->count; i++) {
+        int match = (columns->due_dates[i] >= due_from) & (columns->due_dates[i] <= due_to) &
+                    (columns->completion_dates[i] >= completed_from) &
+                    (columns->completion_dates[i] <= completed_to) &
+                    (!category_id | (columns->category_ids[i] == category_id)) &
+                    (!filter->status | (columns->statuses[i] == filter->status)) &
+                    (!filter->priority | (columns->priorities[i] == filter->priority)) &
+                    (!filter->open_only | (columns->completion_dates[i] == 0));
+        rows[n] = (uint32_t)i;
+        n += match;
+    }
+    return n;
+}
+
+// ---- task images: read-only binary snapshots of the task set ----
+//
+// A task image can be mmap'd and read in place by tools that don't link SQLite:
+//
+//   TaskImageHeader | string heap | status and priority name offsets | TaskImageRecord[]
+//
+// Strings are NUL-terminated and addressed by offset into the heap, where offset 0 means no
+// string. Sections are aligned for direct access, and everything after the header is covered
+// by a checksum that readers only compute when asked.
+
+#define TASK_IMAGE_MAGIC "TODOIMG"
+#define TASK_IMAGE_VERSION 1
+#define TASK_IMAGE_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // TASK_IMAGE_BYTE_ORDER as the writer saw it
+    uint32_t header_size;
+    uint32_t record_size;
+    uint64_t num_records;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t codes_offset;      // uint32_t offsets: MAX_CODES status names, then MAX_CODES priorities
+    uint64_t records_offset;
+    uint64_t checksum;          // FNV-1a over everything from strings_offset to the end
+} TaskImageHeader;
+
+typedef struct {
+    int32_t id;
+    int32_t start_date;         // day numbers, 0 = no date
+    int32_t due_date;
+    int32_t completion_date;
+    uint32_t name;              // string heap offsets, 0 = none
+    uint32_t category;
+    uint32_t description;
+    uint8_t status;
+    uint8_t priority;
+    uint8_t reserved[2];
+} TaskImageRecord;
+
+typedef struct {
+    OutBuffer out;
+    uint64_t heap_size;
+} TaskImageWriter;
+
+static uint32_t put_image_string(TaskImageWriter *writer, const char *text)
+{
+    if (!text) {
+        return 0;
+    }
+
+    uint64_t offset = writer->heap_size;
+    size_t n = strlen(text) + 1;
+    if (offset + n > UINT32_MAX) {
+        writer->out.failed = 1;
+        return 0;
+    }
+    put_bytes(&writer->out, text, n);
+    writer->heap_size += n;
+    return (uint32_t)offset;
+}
+
+static void pad_image(TaskImageWriter *writer, size_t align)
+{
+    while ((writer->out.bytes + writer->out.len) % align) {
+        put_char(&writer->out, '\0');
+    }
+}
+
+// Writes every task to path as a task image. The image is built next to path and renamed
+// over it, so readers never map a half-written file. Records are gathered in memory (32 bytes
+// a task) while the strings stream out ahead of them.
+int write_task_image(TodoDb *db, const char *path)
+{
+    TaskImageHeader header = {.magic = TASK_IMAGE_MAGIC, .version = TASK_IMAGE_VERSION,
+                              .byte_order = TASK_IMAGE_BYTE_ORDER, .header_size = sizeof(TaskImageHeader),
+                              .record_size = sizeof(TaskImageRecord), .checksum = FNV_OFFSET_BASIS};
+    TaskImageWriter writer = {.out = {.size = EXPORT_BUFFER_SIZE, .checksum = &header.checksum}};
+    TaskImageRecord *records = NULL;
+    uint32_t *category_strings = NULL;      // heap offset of each category name, by category id
+    size_t num_categories = 0;
+    size_t capacity = 0;
+    uint32_t codes[2 * MAX_CODES];
+    TaskCursor cursor;
+    const Task *task;
+    char tmp_path[4096];
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    writer.out.fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    writer.out.buf = malloc(writer.out.size);
+    if (writer.out.fd < 0 || !writer.out.buf) {
+        fprintf(stderr, "Cannot write %s: %s\n", tmp_path, writer.out.fd < 0 ? strerror(errno) : "out of memory");
+        free(writer.out.buf);
+        if (writer.out.fd >= 0) {
+            close(writer.out.fd);
+        }
+        return SQLITE_ERROR;
+    }
+    if (task_cursor_open(db, &cursor) != SQLITE_OK) {
+        free(writer.out.buf);
+        close(writer.out.fd);
+        remove(tmp_path);
+        return SQLITE_ERROR;
+    }
+
+    // The header is filled in last; everything after it streams out in file order.
+    lseek(writer.out.fd, sizeof(TaskImageHeader), SEEK_SET);
+    writer.out.bytes = header.strings_offset = sizeof(TaskImageHeader);
+    put_char(&writer.out, '\0');
+    writer.heap_size = 1;
+
+    for (int code = 0; code < MAX_CODES; code++) {
+        codes[code] = put_image_string(&writer, db->status_names[code]);
+        codes[MAX_CODES + code] = put_image_string(&writer, db->priority_names[code]);
+    }
+
+    while (!writer.out.failed && (task = task_cursor_next(&cursor))) {
+        if (header.num_records == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            TaskImageRecord *grown = realloc(records, capacity * sizeof(TaskImageRecord));
+            if (!grown) {
+                writer.out.failed = 1;
+                break;
+            }
+            records = grown;
+        }
+
+        TaskImageRecord *record = &records[header.num_records++];
+        memset(record, 0, sizeof(*record));
+        record->id = task->id;
+        record->start_date = task->start_date;
+        record->due_date = task->due_date;
+        record->completion_date = task->completion_date;
+        record->status = task->status;
+        record->priority = task->priority;
+        record->name = put_image_string(&writer, task->name);
+        record->description = put_image_string(&writer, task->description);
+
+        if (task->category_id > 0) {
+            if ((size_t)task->category_id >= num_categories) {
+                size_t grown_count = task->category_id * 2;
+                uint32_t *grown = realloc(category_strings, grown_count * sizeof(uint32_t));
+                if (!grown) {
+                    writer.out.failed = 1;
+                    break;
+                }
+                memset(grown + num_categories, 0, (grown_count - num_categories) * sizeof(uint32_t));
+                category_strings = grown;
+                num_categories = grown_count;
+            }
+            if (!category_strings[task->category_id]) {
+                category_strings[task->category_id] = put_image_string(&writer, task->category);
+            }
+            record->category = category_strings[task->category_id];
+        }
+    }
+    task_cursor_close(&cursor);
+
+    header.strings_size = writer.heap_size;
+    pad_image(&writer, sizeof(uint32_t));
+    header.codes_offset = writer.out.bytes + writer.out.len;
+    put_bytes(&writer.out, (const char *)codes, sizeof(codes));
+    pad_image(&writer, sizeof(uint64_t));
+    header.records_offset = writer.out.bytes + writer.out.len;
+    put_bytes(&writer.out, (const char *)records, header.num_records * sizeof(TaskImageRecord));
+    flush_out(&writer.out);
+
+    int failed = writer.out.failed ||
+                 pwrite(writer.out.fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+                 fsync(writer.out.fd) != 0;
+    failed |= close(writer.out.fd) != 0;
+    if (!failed && rename(tmp_path, path) != 0) {
+        failed = 1;
+    }
+    if (failed) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        remove(tmp_path);
+    }
+
+    free(records);
+    free(category_strings);
+    free(writer.out.buf);
+    return failed ? SQLITE_IOERR : SQLITE_OK;
+}
+
+// A mapped task image. Opening checks the header and section bounds, which is all that
+// reading needs to be memory safe; the checksum waits for verify_task_image.
+typedef struct {
+    void *map;
+    size_t size;
+    const TaskImageHeader *header;
+    const char *strings;
+    const uint32_t *codes;
+    const TaskImageRecord *records;
+    size_t count;
+    int verified;               // 0 = not checked yet, 1 = checksum matches, -1 = it doesn't
+} TaskImage;
+
+int open_task_image(const char *path, TaskImage *image)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    memset(image, 0, sizeof(*image));
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(TaskImageHeader)) {
+        fprintf(stderr, "%s is not a task image\n", path);
+        close(fd);
+        return -1;
+    }
+
+    image->size = st.st_size;
+    image->map = mmap(NULL, image->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image->map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map %s: %s\n", path, strerror(errno));
+        image->map = NULL;
+        return -1;
+    }
+
+    const TaskImageHeader *header = image->map;
+    const char *base = image->map;
+    const char *problem = NULL;
+
+    if (memcmp(header->magic, TASK_IMAGE_MAGIC, sizeof(header->magic)) != 0) {
+        problem = "not a task image";
+    } else if (header->byte_order != TASK_IMAGE_BYTE_ORDER) {
+        problem = "written on a machine of the other byte order";
+    } else if (header->version > TASK_IMAGE_VERSION) {
+        problem = "written by a newer version";
+    } else if (header->header_size != sizeof(TaskImageHeader) || header->record_size != sizeof(TaskImageRecord)) {
+        problem = "unexpected header or record size";
+    } else if (header->strings_offset != header->header_size || header->strings_size == 0 ||
+               header->strings_size > UINT32_MAX ||
+               // Each section must end by the next one's start. Offsets come from the file, so
+               // compare differences once the order is known; sums of them could wrap.
+               header->codes_offset > image->size || header->codes_offset < header->strings_offset ||
+               header->codes_offset - header->strings_offset < header->strings_size ||
+               header->codes_offset % sizeof(uint32_t) ||
+               header->records_offset > image->size || header->records_offset < header->codes_offset ||
+               header->records_offset - header->codes_offset < 2 * MAX_CODES * sizeof(uint32_t) ||
+               header->records_offset % sizeof(uint64_t) ||
+               header->num_records > (image->size - header->records_offset) / sizeof(TaskImageRecord)) {
+        problem = "sections out of bounds";
+    } else if (base[header->strings_offset + header->strings_size - 1] != '\0') {
+        // With the heap ending in a terminator, any in-range offset reads a terminated string.
+        problem = "string heap not terminated";
+    }
+    if (problem) {
+        fprintf(stderr, "%s: %s\n", path, problem);
+        munmap(image->map, image->size);
+        image->map = NULL;
+        return -1;
+    }
+
+    image->header = header;
+    image->strings = base + header->strings_offset;
+    image->codes = (const uint32_t *)(base + header->codes_offset);
+    image->records = (const TaskImageRecord *)(base + header->records_offset);
+    image->count = header->num_records;
+    return 0;
+}
+
+void close_task_image(TaskImage *image)
+{
+    if (image->map) {
+        munmap(image->map, image->size);
+    }
+    memset(image, 0, sizeof(*image));
+}
+
+// Checks the checksum on first use and remembers the answer. Returns 1 if it matches.
+int verify_task_image(TaskImage *image)
+{
+    if (!image->verified) {
+        const char *base = image->map;
+        uint64_t sum = fnv1a(FNV_OFFSET_BASIS, base + image->header->strings_offset,
+                             image->size - image->header->strings_offset);
+        image->verified = sum == image->header->checksum ? 1 : -1;
+    }
+    return image->verified > 0;
+}
+
+static const char *image_string(const TaskImage *image, uint32_t offset)
+{
+    return offset && offset < image->header->strings_size ? image->strings + offset : NULL;
+}
+
+const char *task_image_status_name(const TaskImage *image, uint8_t code)
+{
+    return image_string(image, image->codes[code]);
+}
+
+const char *task_image_priority_name(const TaskImage *image, uint8_t code)
+{
+    return image_string(image, image->codes[MAX_CODES + code]);
+}
+
+// Task i as a Task whose strings point into the mapping: read-only, and valid until
+// close_task_image. category_id is left 0, since ids only mean something inside a database.
+void task_image_get(const TaskImage *image, size_t i, Task *task)
+{
+    const TaskImageRecord *record = &image->records[i];
+
+    task->id = record->id;
+    task->name = (char *)image_string(image, record->name);
+    task->category = image_string(image, record->category);
+    task->category_id = 0;
+    task->start_date = record->start_date;
+    task->due_date = record->due_date;
+    task->completion_date = record->completion_date;
+    task->status = record->status;
+    task->priority = record->priority;
+    task->description = (char *)image_string(image, record->description);
+}
+
+// The whole image as a TaskList for code written against fetch_tasks. Only the Task array is
+// allocated; the strings stay in the mapping, so free_tasklist before close_task_image.
+TaskList task_image_list(const TaskImage *image)
+{
+    TaskList tasklist = {0};
+
+    tasklist.tasks = malloc((image->count ? image->count : 1) * sizeof(Task));
+    if (!tasklist.tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return tasklist;
+    }
+    tasklist.capacity = image->count;
+    for (size_t i = 0; i < image->count; i++) {
+        task_image_get(image, i, &tasklist.tasks[i]);
+    }
+    tasklist.count = image->count;
+    return tasklist;
+}
+
+// ---- benchmarks (./todo bench [count]) ----
+
+#define BENCH_DB "bench.db"
+
+static void remove_bench_db(void)
+{
+    remove(BENCH_DB);
+    remove(BENCH_DB "-wal");
+    remove(BENCH_DB "-shm");
+}
+
+static TodoDb *open_bench_db(const char *profile_name)
+{
+    const StorageProfile *profile = find_storage_profile(profile_name);
+    if (!profile) {
+        return NULL;
+    }
+
+    remove_bench_db();
+    return open_db(BENCH_DB, profile);
+}
+
+static Task bench_task = {
+    .name = "Benchmark task",
+    .category = "bench",
+    .status = STATUS_TODO,
+    .priority = PRIORITY_LOW,
+    .description = "Inserted by the benchmark",
+};
+
+// The pre-cache add_task: prepare, bind, step and finalize on every call.
+static void insert_task_uncached(TodoDb *db, Task task)
+{
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db->conn, stmt_sql[STMT_INSERT_TASK], -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db->conn));
+        return;
+    }
+    if (bind_task(db, stmt, &task) == 0) {
+        sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+}
+
+static void bench_inserts(int count)
+{
+    for (int cached = 0; cached <= 1; cached++) {
+        // Measure statement overhead, not the disk: bulk-load doesn't wait on fsync.
+        TodoDb *db = open_bench_db("bulk-load");
+        if (!db) {
+            return;
+        }
+
+        double start = now_seconds();
+        for (int i = 0; i < count; i++) {
+            if (cached) {
+                insert_task(db, bench_task);
+            } else {
+                insert_task_uncached(db, bench_task);
+            }
+        }
+        double elapsed = now_seconds() - start;
+
+        printf("insert %-9s %8d tasks  %8.3f s  %10.0f inserts/sec\n",
+               cached ? "cached" : "uncached", count, elapsed, count / elapsed);
+        close_db(db);
+    }
+    remove_bench_db();
+}
+
+// Autocommit-per-row against add_tasks, both paying for real fsyncs.
+static void bench_group_commit(int count)
+{
+    int single_count = count < 2000 ? count : 2000;
+    Task *tasks = malloc(count * sizeof(Task));
+    if (!tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+    }
+
+    TodoDb *db = open_bench_db("durable");
+    if (db) {
+        double start = now_seconds();
+        for (int i = 0; i < single_count; i++) {
+            insert_task(db, bench_task);
+        }
+        double elapsed = now_seconds() - start;
+        printf("insert %-9s %8d tasks  %8.3f s  %10.0f inserts/sec\n", "autocommit", single_count, elapsed, single_count / elapsed);
+        close_db(db);
+    }
+
+    size_t intervals[] = {0, 10000, 1000};
+    for (size_t k = 0; k < sizeof(intervals) / sizeof(intervals[0]); k++) {
+        db = open_bench_db("durable");
+        if (!db) {
+            break;
+        }
+        db->commit_interval = intervals[k];
+
+        double start = now_seconds();
+        size_t added = add_tasks(db, tasks, count, NULL);
+        double elapsed = now_seconds() - start;
+        printf("add_tasks every %-6zu %8zu tasks  %8.3f s  %10.0f inserts/sec\n", intervals[k] ? intervals[k] : (size_t)count, added, elapsed, added / elapsed);
+        close_db(db);
+    }
+
+    free(tasks);
+    remove_bench_db();
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Latency of a single-row autocommit transaction under each storage profile.
+static void bench_commit_latency(int count)
+{
+    double *latencies = malloc(count * sizeof(double));
+    if (!latencies) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return;
+    }
+
+    for (size_t k = 0; k < sizeof(storage_profiles) / sizeof(storage_profiles[0]); k++) {
+        TodoDb *db = open_bench_db(storage_profiles[k].name);
+        if (!db) {
+            break;
+        }
+
+        double total = 0;
+        for (int i = 0; i < count; i++) {
+            double start = now_seconds();
+            insert_task(db, bench_task);
+            latencies[i] = now_seconds() - start;
+            total += latencies[i];
+        }
+        qsort(latencies, count, sizeof(double), compare_doubles);
+
+        printf("commit %-10s %6d commits  avg %8.1f us  p50 %8.1f us  p99 %8.1f us\n",
+               storage_profiles[k].name, count, total / count * 1e6,
+               latencies[count / 2] * 1e6, latencies[(int)(count * 0.99)] * 1e6);
+        close_db(db);
+    }
+
+    free(latencies);
+    remove_bench_db();
+}
+
+// Keyset pages against OFFSET pages at increasing depth into a large table.
+static void bench_pagination(int count)
+{
+    TodoDb *db = open_bench_db("bulk-load");
+    Task *tasks = calloc(count, sizeof(Task));
+    if (!db || !tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        close_db(db);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+        tasks[i].due_date = bench_task.due_date + i % 1000;
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+
+    sqlite3_stmt *offset_stmt;
+    sqlite3_prepare_v2(db->conn, "SELECT Id, Name, CategoryId, StartDate, DueDate, CompletionDate, Status, Priority, Description "
+                                 "FROM Tasks ORDER BY DueDate, Id LIMIT 30 OFFSET ?;", -1, &offset_stmt, NULL);
+
+    for (int depth = 0; depth < count; depth = depth ? depth * 10 : 1000) {
+        // Walk to the page at this depth once to get its key, then time the fetch itself.
+        TaskPageKey key = {0};
+        TaskPage page;
+        int walked = 0;
+        while (walked + 1000 <= depth) {
+            page = fetch_tasks_page(db, walked ? &key : NULL, 1000, TASK_SORT_DUE_DATE);
+            key = page.next;
+            walked += page.list.count;
+            free_tasklist(&page.list);
+        }
+
+        double start = now_seconds();
+        page = fetch_tasks_page(db, walked ? &key : NULL, 30, TASK_SORT_DUE_DATE);
+        double keyset = now_seconds() - start;
+        free_tasklist(&page.list);
+
+        start = now_seconds();
+        sqlite3_bind_int(offset_stmt, 1, walked);
+        TaskList list = collect_tasks(db, offset_stmt);
+        double offset = now_seconds() - start;
+        free_tasklist(&list);
+
+        printf("page at row %8d  keyset %8.1f us  offset %10.1f us\n", walked, keyset * 1e6, offset * 1e6);
+    }
+
+    sqlite3_finalize(offset_stmt);
+    close_db(db);
+    remove_bench_db();
+}
+
+// The pre-arena fetch: one strdup per string column plus one free each to release.
+static void fetch_with_strdup(TodoDb *db, size_t *allocations)
+{
+    TaskList tasklist = {0};
+    TaskCursor cursor;
+    const Task *task;
+
+    task_cursor_open(db, &cursor);
+    while ((task = task_cursor_next(&cursor))) {
+        if (tasklist.count >= tasklist.capacity) {
+            tasklist.capacity = tasklist.capacity ? tasklist.capacity * 2 : 10;
+            tasklist.tasks = realloc(tasklist.tasks, tasklist.capacity * sizeof(Task));
+            (*allocations)++;
+        }
+        Task *copy = &tasklist.tasks[tasklist.count++];
+        *copy = *task;
+        copy->name = task->name ? strdup(task->name) : NULL;
+        copy->description = task->description ? strdup(task->description) : NULL;
+        *allocations += (copy->name != NULL) + (copy->description != NULL);
+    }
+    task_cursor_close(&cursor);
+
+    for (size_t i = 0; i < tasklist.count; i++) {
+        free_task(&tasklist.tasks[i]);
+    }
+    free(tasklist.tasks);
+}
+
+static long max_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Allocation count and peak RSS growth of one full fetch, per-string strdup vs arena.
+// Each variant runs in its own child process so the peaks don't mask each other.
+static void bench_fetch_memory(int count)
+{
+    TodoDb *db = open_bench_db("bulk-load");
+    Task *tasks = malloc(count * sizeof(Task));
+    if (!db || !tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        close_db(db);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+    close_db(db);
+
+    for (int use_arena = 0; use_arena <= 1; use_arena++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            db = open_db(BENCH_DB, find_storage_profile("bulk-load"));
+            long rss_before = max_rss_kb();
+            size_t allocations = 0;
+            double start = now_seconds();
+
+            if (use_arena) {
+                TaskList tasklist = fetch_tasks(db);
+                allocations = tasklist.arena.num_chunks + 1;
+                for (size_t capacity = 64; capacity < tasklist.capacity; capacity *= 2) {
+                    allocations++;
+                }
+                free_tasklist(&tasklist);
+            } else {
+                fetch_with_strdup(db, &allocations);
+            }
+
+            double elapsed = now_seconds() - start;
+            printf("fetch %-7s %8d rows  %8.3f s  %9zu allocations  +%ld KiB peak RSS\n",
+                   use_arena ? "arena" : "strdup", count, elapsed, allocations, max_rss_kb() - rss_before);
+            close_db(db);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    remove_bench_db();
+}
+
+#define BENCH_IMAGE "bench.img"
+
+// Writing a task image, then reading it back: mapping it, an overdue scan straight over the
+// records, the lazy checksum, and a TaskList view, next to fetch_tasks for the same list.
+static void bench_image(int count)
+{
+    TodoDb *db = open_bench_db("bulk-load");
+    Task *tasks = calloc(count, sizeof(Task));
+    if (!db || !tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        close_db(db);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+        tasks[i].due_date = bench_task.due_date + i % 365;
+        tasks[i].status = 1 + i % 3;
+        tasks[i].completion_date = tasks[i].status == STATUS_DONE ? tasks[i].due_date : 0;
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+
+    double start = now_seconds();
+    int rc = write_task_image(db, BENCH_IMAGE);
+    double elapsed = now_seconds() - start;
+    if (rc != SQLITE_OK) {
+        close_db(db);
+        remove_bench_db();
+        return;
+    }
+    struct stat st;
+    stat(BENCH_IMAGE, &st);
+    printf("image write      %8d tasks  %8.3f s  %6.1f MB\n", count, elapsed, st.st_size / 1e6);
+
+    TaskImage image;
+    start = now_seconds();
+    if (open_task_image(BENCH_IMAGE, &image) != 0) {
+        close_db(db);
+        remove_bench_db();
+        return;
+    }
+    Task first;
+    task_image_get(&image, 0, &first);
+    printf("image open       %8zu tasks  %8.3f ms to the first task\n", image.count, (now_seconds() - start) * 1e3);
+
+    int day = bench_task.due_date + 180;
+    size_t overdue = 0;
+    start = now_seconds();
+    for (size_t i = 0; i < image.count; i++) {
+        overdue += image.records[i].due_date && image.records[i].due_date < day && !image.records[i].completion_date;
+    }
+    printf("image overdue    %8zu tasks  %8.3f ms\n", overdue, (now_seconds() - start) * 1e3);
+
+    start = now_seconds();
+    int ok = verify_task_image(&image);
+    printf("image checksum   %8s        %8.3f ms\n", ok ? "ok" : "BAD", (now_seconds() - start) * 1e3);
+
+    start = now_seconds();
+    TaskList view = task_image_list(&image);
+    printf("image list       %8zu tasks  %8.3f ms\n", view.count, (now_seconds() - start) * 1e3);
+    free_tasklist(&view);
+    close_task_image(&image);
+
+    start = now_seconds();
+    TaskList fetched = fetch_tasks(db);
+    printf("fetch_tasks      %8zu tasks  %8.3f ms\n", fetched.count, (now_seconds() - start) * 1e3);
+    free_tasklist(&fetched);
+
+    close_db(db);
+    remove(BENCH_IMAGE);
+    remove_bench_db();
+}
+
+#define BENCH_EXPORT "bench-export.out"
+
+// Each export format through the cursor and output buffer, against the cursor alone and
+// list_tasks printing the same rows field by field with printf.
+static void bench_export(int count)
+{
+    TodoDb *db = open_bench_db("bulk-load");
+    Task *tasks = calloc(count, sizeof(Task));
+    if (!db || !tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        close_db(db);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+        tasks[i].due_date = bench_task.due_date + i % 1000;
+        tasks[i].status = 1 + i % 3;
+        tasks[i].description = i % 10 ? "Sample task description" : "Needs \"quotes\", commas\nand a line break";
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+
+    TaskCursor cursor;
+    if (task_cursor_open(db, &cursor) == SQLITE_OK) {
+        size_t rows = 0;
+        double start = now_seconds();
+        while (task_cursor_next(&cursor)) {
+            rows++;
+        }
+        double elapsed = now_seconds() - start;
+        task_cursor_close(&cursor);
+        printf("export %-10s %8zu rows  %8.3f s  %10.0f rows/s\n", "cursor", rows, elapsed, rows / elapsed);
+    }
+
+    for (int format = 0; format < NUM_OF_EXPORT_FORMATS; format++) {
+        ExportStats stats;
+        int fd = open(BENCH_EXPORT, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            break;
+        }
+        double start = now_seconds();
+        export_tasks(db, fd, format, 0, &stats);
+        double elapsed = now_seconds() - start;
+        close(fd);
+
+        printf("export %-10s %8zu rows  %8.3f s  %10.0f rows/s  %7.1f MB/s  %6zu writes\n", export_format_names[format],
+               stats.rows, elapsed, stats.rows / elapsed, stats.bytes / elapsed / 1e6, stats.writes);
+    }
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int fd = open(BENCH_EXPORT, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (saved >= 0 && fd >= 0) {
+        dup2(fd, STDOUT_FILENO);
+        double start = now_seconds();
+        list_tasks(db);
+        fflush(stdout);
+        double elapsed = now_seconds() - start;
+        off_t bytes = lseek(fd, 0, SEEK_END);
+        dup2(saved, STDOUT_FILENO);
+
+        printf("export %-10s %8d rows  %8.3f s  %10.0f rows/s  %7.1f MB/s\n", "list_tasks", count, elapsed,
+               count / elapsed, bytes / elapsed / 1e6);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (saved >= 0) {
+        close(saved);
+    }
+
+    close_db(db);
+    remove(BENCH_EXPORT);
+    remove_bench_db();
+}
+
+#define BENCH_IMPORT_CSV "bench-import.csv"
+
+// Streaming import of a generated dump with quoted fields, at a tenth of count rows and at count
+// rows, plus the parser alone. Each import is its own process so the peak RSS growth of one
+// doesn't hide the other's; the durable profile keeps SQLite's page cache at 2 MB so that
+// growth is down to the import itself.
+static void bench_import(int count)
+{
+    static const char *statuses[] = {"todo", "in progress", "done"};
+    int sizes[] = {count / 10 ? count / 10 : 1, count};
+
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        FILE *file = fopen(BENCH_IMPORT_CSV, "w");
+        if (!file) {
+            fprintf(stderr, "Cannot open %s\n", BENCH_IMPORT_CSV);
+            return;
+        }
+        fprintf(file, "Name,Category,StartDate,DueDate,Status,Priority,Description\n");
+        for (int i = 0; i < sizes[k]; i++) {
+            fprintf(file, "Task %d,project-%d,,%02d-%02d-2024,%s,%s,\"Imported from the old tracker, \"\"row\"\" %d\"\n",
+                    i, i % 50, 1 + i % 12, 1 + i % 28, statuses[i % 3], i % 2 ? "high" : "low", i);
+        }
+        fclose(file);
+
+        CsvReader reader;
+        size_t records = 0;
+        file = fopen(BENCH_IMPORT_CSV, "rb");
+        if (file && open_csv(&reader, file, CSV_BUFFER_SIZE) == 0) {
+            double start = now_seconds();
+            while (read_csv_record(&reader) != 0) {
+                records++;
+            }
+            double elapsed = now_seconds() - start;
+            printf("import %8zu rows  %8.3f s  %9.0f rows/s  %6.1f MB/s  parse only\n",
+                   records - 1, elapsed, (records - 1) / elapsed, ftell(file) / elapsed / 1e6);
+            close_csv(&reader);
+        }
+        if (file) {
+            fclose(file);
+        }
+
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            TodoDb *db = open_bench_db("durable");
+            ImportOptions options = {0};
+            ImportStats stats;
+            file = fopen(BENCH_IMPORT_CSV, "rb");
+            if (!db || !file) {
+                _exit(1);
+            }
+
+            long rss_before = max_rss_kb();
+            double start = now_seconds();
+            import_csv(db, file, BENCH_IMPORT_CSV, &options, &stats);
+            double elapsed = now_seconds() - start;
+
+            printf("import %8zu rows  %8.3f s  %9.0f rows/s  %6.1f MB/s  %zu errors  +%ld KiB peak RSS\n",
+                   stats.imported, elapsed, stats.imported / elapsed, stats.bytes / elapsed / 1e6,
+                   stats.errors, max_rss_kb() - rss_before);
+            fclose(file);
+            close_db(db);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    remove(BENCH_IMPORT_CSV);
+    remove_bench_db();
+}
+
+// Dashboard-style scans over the columnar copy against the same scans over a TaskList.
+static void bench_columns(int count)
+{
+    TodoDb *db = open_bench_db("bulk-load");
+    Task *tasks = malloc(count * sizeof(Task));
+    uint32_t *rows = malloc(count * sizeof(uint32_t));
+    if (!db || !tasks || !rows) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        free(rows);
+        close_db(db);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+        tasks[i].due_date = bench_task.due_date + i % 365;
+        tasks[i].status = 1 + i % 3;
+        tasks[i].completion_date = tasks[i].status == STATUS_DONE ? tasks[i].due_date : 0;
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+
+    TaskColumns columns = {0};
+    double start = now_seconds();
+    load_task_columns(db, &columns);
+    printf("columns load  %8zu rows  %8.3f ms\n", columns.count, (now_seconds() - start) * 1e3);
+
+    TaskList tasklist = fetch_tasks(db);
+    int today = bench_task.due_date + 180;
+    TaskFilter filter = {.status = STATUS_TODO, .due_from = today, .due_to = today + 7};
+    size_t counts[MAX_CODES];
+    size_t n = 0;
+
+    start = now_seconds();
+    n = count_overdue(&columns, today);
+    printf("columns overdue        %8zu  %8.3f ms\n", n, (now_seconds() - start) * 1e3);
+
+    start = now_seconds();
+    n = 0;
+    for (size_t i = 0; i < tasklist.count; i++) {
+        const Task *task = &tasklist.tasks[i];
+        n += task->completion_date == 0 && task->due_date > 0 && task->due_date < today;
+    }
+    printf("tasklist overdue       %8zu  %8.3f ms\n", n, (now_seconds() - start) * 1e3);
+
+    start = now_seconds();
+    n = count_due_between(&columns, today, today + 7);
+    printf("columns due this week  %8zu  %8.3f ms\n", n, (now_seconds() - start) * 1e3);
+
+    start = now_seconds();
+    count_by_status(&columns, counts);
+    printf("columns by status      %8zu  %8.3f ms\n", counts[STATUS_TODO], (now_seconds() - start) * 1e3);
+
+    start = now_seconds();
+    n = filter_task_columns(&columns, &filter, 0, rows);
+    printf("columns filter         %8zu  %8.3f ms\n", n, (now_seconds() - start) * 1e3);
+
+    free_tasklist(&tasklist);
+    free_task_columns(&columns);
+    free(rows);
+    close_db(db);
+    remove_bench_db();
+}
+
+static const char *bench_words[] = {
+    "report", "invoice", "meeting", "review", "draft", "budget", "release", "backup",
+    "garden", "groceries", "dentist", "taxes", "laundry", "plan", "email", "call",
+    "weekly", "monthly", "client", "server", "design", "test", "deploy", "notes",
+    "kitchen", "car", "insurance", "renew", "book", "flight", "hotel", "birthday",
+};
+
+#define NUM_OF_BENCH_WORDS (sizeof(bench_words) / sizeof(bench_words[0]))
+#define BENCH_WORD_VARIANTS 64  // "taxes0" .. "taxes63", for a vocabulary of about 2000 terms
+
+// Writes words pseudo-random terms (seeded by *state) to text.
+static void bench_text(char *text, size_t size, int words, unsigned *state)
+{
+    size_t len = 0;
+
+    text[0] = '\0';
+    for (int i = 0; i < words && len < size; i++) {
+        *state = *state * 1103515245 + 12345;
+        unsigned pick = (*state >> 8) % (NUM_OF_BENCH_WORDS * BENCH_WORD_VARIANTS);
+        len += snprintf(text + len, size - len, "%s%s%u", i ? " " : "",
+                        bench_words[pick % NUM_OF_BENCH_WORDS], (unsigned)(pick / NUM_OF_BENCH_WORDS));
+    }
+}
+
+// Search latency by query kind, against the strstr scan over every task it replaces.
+static void bench_search(int count)
+{
+    static const char *queries[][2] = {
+        {"term", "taxes7"},
+        {"two terms", "client3 invoice5"},
+        {"prefix", "deploy1*"},
+        {"phrase", "\"weekly2 report4\""},
+        {"name only", "name:dentist9"},
+    };
+    enum { RUNS = 200, LIMIT = 20 };
+    double latencies[RUNS];
+    char names[64], descriptions[128];
+    unsigned state = 1;
+
+    TodoDb *db = open_bench_db("bulk-load");
+    Task *tasks = malloc(count * sizeof(Task));
+    char *text = malloc((size_t)count * (sizeof(names) + sizeof(descriptions)));
+    if (!db || !tasks || !text) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        free(text);
+        close_db(db);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        char *name = text + (size_t)i * (sizeof(names) + sizeof(descriptions));
+        char *description = name + sizeof(names);
+        bench_text(name, sizeof(names), 3, &state);
+        bench_text(description, sizeof(descriptions), 10, &state);
+        tasks[i] = bench_task;
+        tasks[i].name = name;
+        tasks[i].description = description;
+    }
+
+    double start = now_seconds();
+    add_tasks(db, tasks, count, NULL);
+    printf("search index   %8d rows  %8.3f s  (insert with triggers)\n", count, now_seconds() - start);
+    free(tasks);
+    free(text);
+
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        for (int run = 0; run < RUNS; run++) {
+            start = now_seconds();
+            TaskMatches matches = search_tasks(db, queries[q][1], LIMIT);
+            latencies[run] = now_seconds() - start;
+            free_task_matches(&matches);
+        }
+        qsort(latencies, RUNS, sizeof(double), compare_doubles);
+        printf("search %-10s p50 %8.3f ms  p99 %8.3f ms\n", queries[q][0],
+               latencies[RUNS / 2] * 1e3, latencies[RUNS * 99 / 100] * 1e3);
+    }
+
+    TaskCursor cursor;
+    const Task *task;
+    size_t found = 0;
+
+    start = now_seconds();
+    if (task_cursor_open(db, &cursor) == SQLITE_OK) {
+        while ((task = task_cursor_next(&cursor))) {
+            found += strstr(task->name, "taxes7") || (task->description && strstr(task->description, "taxes7"));
+        }
+        task_cursor_close(&cursor);
+    }
+    printf("search strstr scan     %8.3f ms  (%zu matches, unranked)\n", (now_seconds() - start) * 1e3, found);
+
+    close_db(db);
+    remove_bench_db();
+}
+
+// ./todo plans: EXPLAIN QUERY PLAN for every filter shape, failing if one falls back to a table scan.
+static int check_query_plans(TodoDb *db)
+{
+    int failures = 0;
+
+    // Bulk updates share the WHERE clause of deletes, so deletes stand in for both. Selects
+    // by completion date sort their (range-limited) matches, so only deletes check those.
+    for (int op = FILTER_SELECT; op <= FILTER_DELETE; op++) {
+        int num_shapes = op == FILTER_SELECT ? FILTER_COMPLETED_BEFORE : NUM_OF_FILTER_SHAPES;
+        for (int shape = op == FILTER_DELETE; shape < num_shapes; shape++) {
+            if ((shape & FILTER_OPEN) && (shape & FILTER_COMPLETED_BEFORE)) {
+                continue;           // can't match anything
+            }
+
+            TaskFilter filter = {
+                .category = shape & FILTER_CATEGORY ? "work" : NULL,
+                .status = shape & FILTER_STATUS ? STATUS_TODO : 0,
+                .priority = shape & FILTER_PRIORITY ? PRIORITY_HIGH : 0,
+                .open_only = shape & FILTER_OPEN,
+                .due_from = shape & FILTER_DUE_FROM ? today() : 0,
+                .due_to = shape & FILTER_DUE_TO ? today() + 7 : 0,
+                .completed_before = shape & FILTER_COMPLETED_BEFORE ? today() - 30 : 0,
+            };
+
+            printf("%s%s%s%s%s%s%s%s%s:\n", op == FILTER_DELETE ? "delete " : "",
+                   filter.category ? "category " : "", filter.status ? "status " : "",
+                   filter.priority ? "priority " : "", filter.open_only ? "open " : "",
+                   filter.due_from ? "due_from " : "", filter.due_to ? "due_to " : "",
+                   filter.completed_before ? "completed_before " : "", shape ? "" : "(all)");
+            if (explain_tasks_where(db, op, &filter)) {
+                printf("    ^ full table scan or sort\n");
+                failures++;
+            }
+        }
+    }
+
+    int page_stmts[] = {STMT_PAGE_BY_ID, STMT_PAGE_BY_DUE_DATE, STMT_PAGE_UNDATED};
+    for (size_t i = 0; i < sizeof(page_stmts) / sizeof(page_stmts[0]); i++) {
+        printf("page %zu:\n", i);
+        if (explain_stmt(db, acquire_stmt(db, page_stmts[i]))) {
+            printf("    ^ full table scan or sort\n");
+            failures++;
+        }
+    }
+
+    return failures ? 1 : 0;
+}
+
+// ./todo statuses [add NAME...]: list the status set, or extend it for every later run.
+static int manage_statuses(TodoDb *db, int argc, char **argv)
+{
+    if (argc > 0 && strcmp(argv[0], "add") == 0) {
+        for (int i = 1; i < argc; i++) {
+            if (!define_status(db, argv[i])) {
+                return 1;
+            }
+        }
+    } else if (argc > 0) {
+        fprintf(stderr, "usage: todo statuses [add NAME...]\n");
+        return 1;
+    }
+
+    for (int code = 1; code < MAX_CODES; code++) {
+        if (status_name(db, code)) {
+            printf("%3d  %s\n", code, status_name(db, code));
+        }
+    }
+    return 0;
+}
+
+// ./todo categories [rename OLD NEW]
+static int manage_categories(TodoDb *db, int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[0], "rename") == 0) {
+        if (rename_category(db, argv[1], argv[2]) != SQLITE_OK) {
+            return 1;
+        }
+    } else if (argc > 0) {
+        fprintf(stderr, "usage: todo categories [rename OLD NEW]\n");
+        return 1;
+    }
+
+    for (int id = 1; id < db->categories.capacity; id++) {
+        if (db->categories.names[id]) {
+            printf("%3d  %s\n", id, db->categories.names[id]);
+        }
+    }
+    return 0;
+}
+
+// ./todo changes [SEQ] | consume NAME | forget NAME: print the journal after SEQ; print a
+// consumer's unacknowledged changes and acknowledge them; or unregister a consumer.
+static int changes_command(TodoDb *db, int argc, char **argv)
+{
+    static const char *op_names[] = {[CHANGE_INSERT] = "insert", [CHANGE_UPDATE] = "update", [CHANGE_DELETE] = "delete"};
+    TaskChange changes[256];
+    const char *consumer = NULL;
+    sqlite3_int64 seq = 0;
+    size_t n;
+
+    if (argc == 2 && strcmp(argv[0], "forget") == 0) {
+        return remove_consumer(db, argv[1]) == SQLITE_OK ? 0 : 1;
+    } else if (argc == 2 && strcmp(argv[0], "consume") == 0) {
+        consumer = argv[1];
+        seq = register_consumer(db, consumer);
+        if (seq < 0) {
+            return 1;
+        }
+    } else if (argc == 1) {
+        seq = atoll(argv[0]);
+    } else if (argc > 0) {
+        fprintf(stderr, "usage: todo changes [SEQ] | consume NAME | forget NAME\n");
+        return 1;
+    }
+
+    while ((n = changes_since(db, seq, changes, sizeof(changes) / sizeof(changes[0]))) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            printf("%lld  %-6s  %d\n", (long long)changes[i].seq,
+                   changes[i].op <= CHANGE_DELETE ? op_names[changes[i].op] : "?", changes[i].task_id);
+        }
+        seq = changes[n - 1].seq;
+    }
+
+    if (consumer && ack_changes(db, consumer, seq) != SQLITE_OK) {
+        return 1;
+    }
+    return 0;
+}
+
+// ./todo search QUERY [LIMIT]: ranked matches with their snippets.
+static int search_command(TodoDb *db, int argc, char **argv)
+{
+    int limit = argc > 1 ? atoi(argv[1]) : 20;
+    if (argc < 1 || argc > 2 || limit <= 0) {
+        fprintf(stderr, "usage: todo search QUERY [LIMIT]\n");
+        return 1;
+    }
+
+    TaskMatches matches = search_tasks(db, argv[0], limit);
+    for (size_t i = 0; i < matches.list.count; i++) {
+        printf("%5d  %8.3f  %s\n", matches.list.tasks[i].id, matches.ranks[i], matches.list.tasks[i].name);
+        printf("       %s\n", or_blank(matches.snippets[i]));
+    }
+    free_task_matches(&matches);
+    return 0;
+}
+
+// ./todo import FILE|- [FIELD=COLUMN...]: FIELD is one of Name, Category, StartDate, DueDate,
+// Status, Priority, Description; COLUMN is a header name, a 1-based column number, or empty.
+static int import_command(TodoDb *db, int argc, char **argv)
+{
+    ImportOptions options = {0};
+    ImportStats stats;
+    FILE *file;
+
+    if (argc < 1) {
+        fprintf(stderr, "usage: todo import FILE|- [FIELD=COLUMN...]\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        char *eq = strchr(argv[i], '=');
+        int f = 0;
+
+        while (eq && f < NUM_OF_IMPORT_FIELDS &&
+               (strncasecmp(argv[i], import_field_names[f], eq - argv[i]) != 0 || import_field_names[f][eq - argv[i]])) {
+            f++;
+        }
+        if (!eq || f == NUM_OF_IMPORT_FIELDS) {
+            fprintf(stderr, "Expected FIELD=COLUMN, got %s\n", argv[i]);
+            return 1;
+        }
+        options.columns[f] = eq + 1;
+    }
+
+    file = strcmp(argv[0], "-") == 0 ? stdin : fopen(argv[0], "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s: %s\n", argv[0], strerror(errno));
+        return 1;
+    }
+
+    double start = now_seconds();
+    int rc = import_csv(db, file, argv[0], &options, &stats);
+    double elapsed = now_seconds() - start;
+    if (file != stdin) {
+        fclose(file);
+    }
+    if (rc != SQLITE_OK && !stats.rows) {
+        return 1;
+    }
+
+    printf("Imported %zu of %zu rows (%zu errors) in %.2f s\n", stats.imported, stats.rows, stats.errors, elapsed);
+    return rc != SQLITE_OK ? 1 : stats.errors ? 2 : 0;
+}
+
+// ./todo export csv|jsonl|md [FILE]: every task, to FILE or standard output.
+static int export_command(TodoDb *db, int argc, char **argv)
 {
-    sqlite3 *db;
-    char *err_msg = 0;
-    int rc;
-    const char *sql;
+    ExportStats stats;
+    int format = 0;
+    int fd = STDOUT_FILENO;
 
-    rc = sqlite3_open("todo.db", &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return;
+    while (argc >= 1 && format < NUM_OF_EXPORT_FORMATS && strcmp(argv[0], export_format_names[format]) != 0) {
+        format++;
+    }
+    if (argc < 1 || argc > 2 || format == NUM_OF_EXPORT_FORMATS) {
+        fprintf(stderr, "usage: todo export csv|jsonl|md [FILE]\n");
+        return 1;
     }
 
-    sql = "CREATE TABLE IF NOT EXISTS Tasks("
-                      "Id INTEGER PRIMARY KEY, "
-                      "Name TEXT NOT NULL, "
-                      "Category TEXT, "
-                      "StartDate DATE, "
-                      "DueDate DATE, "
-                      "CompletionDate DATE, "
-                      "Status TEXT, "
-                      "Priority TEXT, "
-                      "Description TEXT);";
+    if (argc == 2 && (fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    int rc = export_tasks(db, fd, format, 0, &stats);
+    if (fd != STDOUT_FILENO && close(fd) != 0) {
+        fprintf(stderr, "Cannot write %s: %s\n", argv[1], strerror(errno));
+        rc = SQLITE_IOERR;
+    }
+    return rc == SQLITE_OK ? 0 : 1;
+}
 
-    rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
-        sqlite3_close(db);
+// ./todo image write FILE | check FILE: write a task image, or verify one and summarize it
+// without going through SQLite.
+static int image_command(TodoDb *db, int argc, char **argv)
+{
+    if (argc == 2 && strcmp(argv[0], "write") == 0) {
+        return write_task_image(db, argv[1]) == SQLITE_OK ? 0 : 1;
+    }
+    if (argc == 2 && strcmp(argv[0], "check") == 0) {
+        TaskImage image;
+        size_t counts[MAX_CODES] = {0};
+        size_t overdue = 0;
+        int day = today();
+
+        if (open_task_image(argv[1], &image) != 0) {
+            return 1;
+        }
+        if (!verify_task_image(&image)) {
+            fprintf(stderr, "%s: checksum mismatch\n", argv[1]);
+            close_task_image(&image);
+            return 1;
+        }
+        for (size_t i = 0; i < image.count; i++) {
+            const TaskImageRecord *record = &image.records[i];
+            counts[record->status]++;
+            overdue += record->due_date && record->due_date < day && !record->completion_date;
+        }
+
+        printf("%zu tasks, %zu overdue, checksum ok\n", image.count, overdue);
+        for (int code = 0; code < MAX_CODES; code++) {
+            if (counts[code]) {
+                const char *name = task_image_status_name(&image, code);
+                printf("%8zu  %s\n", counts[code], name ? name : "(no status)");
+            }
+        }
+        close_task_image(&image);
+        return 0;
+    }
+
+    fprintf(stderr, "usage: todo image write FILE | check FILE\n");
+    return 1;
+}
+
+// ./todo page-size [BYTES]: show the file's page size, or rebuild the file with a new one.
+static int page_size_command(TodoDb *db, int argc, char **argv)
+{
+    if (argc == 1) {
+        int page_size = atoi(argv[0]);
+        // SQLite silently keeps the old size for anything but a power of two in 512..65536.
+        if (page_size < 512 || page_size > 65536 || (page_size & (page_size - 1))) {
+            fprintf(stderr, "Page size must be a power of two from 512 to 65536\n");
+            return 1;
+        }
+        if (change_page_size(db, page_size) != SQLITE_OK) {
+            return 1;
+        }
+    } else if (argc > 1) {
+        fprintf(stderr, "usage: todo page-size [BYTES]\n");
+        return 1;
+    }
+    printf("%d\n", get_page_size(db->conn));
+    return 0;
+}
+
+// ./todo search-index rebuild | merge [PAGES]: rebuild the full-text index from scratch, or
+// merge its segments a bounded number of pages per transaction until there is nothing left.
+static int manage_search_index(TodoDb *db, int argc, char **argv)
+{
+    if (argc == 1 && strcmp(argv[0], "rebuild") == 0) {
+        return rebuild_search_index(db) == SQLITE_OK ? 0 : 1;
+    }
+    if ((argc == 1 || argc == 2) && strcmp(argv[0], "merge") == 0) {
+        int pages = argc == 2 ? atoi(argv[1]) : 256;
+        int steps = 0;
+        int rc;
+
+        while ((rc = merge_search_index(db, pages)) > 0) {
+            steps++;
+        }
+        printf("%d merge steps of %d pages\n", steps, pages);
+        return rc < 0 ? 1 : 0;
+    }
+
+    fprintf(stderr, "usage: todo search-index rebuild | merge [PAGES]\n");
+    return 1;
+}
+
+// Repeated get_task_by_id over a skewed id mix: nine in ten lookups go to a hot 1% of tasks.
+static void bench_cache(int count)
+{
+    static const size_t limits[] = {0, 64 * 1024, DEFAULT_TASK_CACHE_BYTES};
+    enum { LOOKUPS = 200000 };
+    TodoDb *db = open_bench_db("balanced");
+    Task *tasks = calloc(count, sizeof(Task));
+    if (!db || !tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        close_db(db);
         return;
     }
 
-    sqlite3_close(db);
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+
+    int hot = count / 100 ? count / 100 : 1;
+    for (size_t k = 0; k < sizeof(limits) / sizeof(limits[0]); k++) {
+        unsigned state = 1;
+
+        set_task_cache_limit(db, limits[k]);
+        db->cache.hits = db->cache.misses = db->cache.evictions = 0;
+
+        double start = now_seconds();
+        for (int i = 0; i < LOOKUPS; i++) {
+            state = state * 1103515245 + 12345;
+            int id = 1 + (int)((state >> 8) % ((state & 0xff) < 230 ? hot : count));
+            get_task_by_id(db, id);
+            if (i % 1000 == 0) {
+                Task edit = {.priority = PRIORITY_HIGH};
+                edit_task(db, id, edit);
+            }
+        }
+        double elapsed = now_seconds() - start;
+
+        printf("cache %7zu KiB  %8.0f lookups/s  %5.1f%% hits  %zu evictions  %zu KiB used\n",
+               limits[k] / 1024, LOOKUPS / elapsed, 100.0 * db->cache.hits / LOOKUPS,
+               db->cache.evictions, db->cache.bytes / 1024);
+    }
+
+    close_db(db);
+    remove_bench_db();
 }
 
-void add_task(sqlite3 *db, Task task)
+typedef struct {
+    TodoPool *pool;
+    int shared;                 // every thread goes through the writer connection instead
+    int count;
+    unsigned seed;
+    double deadline;
+    size_t reads;
+} PoolBenchThread;
+
+static void *pool_bench_thread(void *arg)
 {
-    sqlite3_stmt *stmt;
-    int rc;
-    const char *sql;
+    PoolBenchThread *thread = arg;
+    unsigned state = thread->seed;
 
-    sql = "INSERT INTO Tasks (Name, Category, StartDate, DueDate, CompletionDate, Status, Priority, Description) VALUES (?, ?, ?, ?, ?, ?, ?, ?);";
-    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db));
+    while (now_seconds() < thread->deadline) {
+        state = state * 1103515245 + 12345;
+        TaskPageKey after = {.id = (int)((state >> 8) % thread->count)};
+        TodoDb *db = thread->shared ? acquire_writer(thread->pool) : acquire_reader(thread->pool);
+
+        TaskPage page = fetch_tasks_page(db, &after, 50, TASK_SORT_ID);
+        free_tasklist(&page.list);
+
+        if (thread->shared) {
+            release_writer(thread->pool);
+        } else {
+            release_reader(thread->pool, db);
+        }
+        thread->reads++;
+    }
+    return NULL;
+}
+
+// Page reads per second from 1 to 16 threads, each thread on its own pooled read-only
+// connection, against the same threads sharing one connection.
+static void bench_reader_pool(int count)
+{
+    enum { MAX_THREADS = 16 };
+    const StorageProfile *profile = find_storage_profile(DEFAULT_STORAGE_PROFILE);
+    PoolBenchThread threads[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+
+    TodoDb *db = open_bench_db(DEFAULT_STORAGE_PROFILE);
+    Task *tasks = calloc(count, sizeof(Task));
+    if (!db || !tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        close_db(db);
         return;
     }
-    
-    const char *task_data[] = {task.name, task.category, task.start_date, task.due_date, task.completion_date, task.status, task.priority, task.description};
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+    close_db(db);
 
-    for (int i = 0; i < NUM_OF_COLS; i++) {
-        sqlite3_bind_text(stmt, i + 1, task_data[i] ? task_data[i] : NULL, -1, SQLITE_TRANSIENT);
+    TodoPool *pool = open_pool(BENCH_DB, profile, MAX_THREADS);
+    if (!pool) {
+        remove_bench_db();
+        return;
     }
 
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_DONE) {
-        fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db));
-    } else {
-        printf("Task added successfully\n");
+    printf("threads  pool reads/s  shared reads/s  (%ld CPUs)\n", sysconf(_SC_NPROCESSORS_ONLN));
+    for (int n = 1; n <= MAX_THREADS; n *= 2) {
+        double rates[2];
+
+        for (int shared = 0; shared < 2; shared++) {
+            double start = now_seconds();
+            size_t reads = 0;
+
+            for (int i = 0; i < n; i++) {
+                threads[i] = (PoolBenchThread){.pool = pool, .shared = shared, .count = count,
+                                               .seed = i + 1, .deadline = start + 1.0};
+                pthread_create(&ids[i], NULL, pool_bench_thread, &threads[i]);
+            }
+            for (int i = 0; i < n; i++) {
+                pthread_join(ids[i], NULL);
+                reads += threads[i].reads;
+            }
+            rates[shared] = reads / (now_seconds() - start);
+        }
+        printf("%7d  %12.0f  %14.0f\n", n, rates[0], rates[1]);
     }
 
+    close_pool(pool);
+    remove_bench_db();
 }
 
-const char* get_column_text(sqlite3_stmt *stmt, int col) {
-    const unsigned char* text = sqlite3_column_text(stmt, col);
-    return text ? (const char*)text : NULL;
+typedef struct {
+    TodoDb *db;                 // direct mode: shared, guarded by lock
+    pthread_mutex_t *lock;
+    TaskWriter *writer;         // writer modes
+    int wait;                   // writer mode: wait for each result before the next submit
+    int adds;
+} WriterBenchThread;
+
+static void count_completion(const Mutation *mutation, void *arg)
+{
+    atomic_fetch_add((atomic_int *)arg, mutation->result >= 0);
 }
 
-Task get_task_by_id(sqlite3 *db, int task_id) {
-    sqlite3_stmt *stmt;
-    const char *sql = "SELECT Name, Category, StartDate, DueDate, CompletionDate, Status, Priority, Description FROM Tasks WHERE Id = ?;";
-    Task task = {0};
+static atomic_int bench_completed;
 
-    sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    sqlite3_bind_int(stmt, 1, task_id);
+static void *writer_bench_thread(void *arg)
+{
+    WriterBenchThread *thread = arg;
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        for (int i = 0; i < NUM_OF_COLS; i++) {
-            const char *colText = (const char *)sqlite3_column_text(stmt, i);
-            if (colText) {
-                char *temp = malloc(strlen(colText) + 1);
-                if (temp) {
-                    strcpy(temp, colText);
-                }
-                *((char **)&task + i) = temp;
+    for (int i = 0; i < thread->adds; i++) {
+        if (!thread->writer) {
+            pthread_mutex_lock(thread->lock);
+            insert_task(thread->db, bench_task);
+            pthread_mutex_unlock(thread->lock);
+        } else if (thread->wait) {
+            Mutation *mutation = add_mutation(&bench_task);
+            submit_mutation(thread->writer, mutation, NULL, NULL);
+            wait_mutation(thread->writer, mutation);
+        } else {
+            submit_mutation(thread->writer, add_mutation(&bench_task), count_completion, &bench_completed);
+        }
+    }
+    return NULL;
+}
+
+// Concurrent producers on the durable profile: each add in its own transaction on a shared
+// connection, against the writer thread's group commit with producers waiting on every
+// result (committing whatever is queued, or holding each commit open for 1 ms) or only
+// submitting.
+static void bench_writer(int count)
+{
+    static const char *modes[] = {"direct", "wait", "wait 1ms", "async 1ms"};
+    enum { MAX_THREADS = 16 };
+    WriterBenchThread threads[MAX_THREADS];
+    pthread_t ids[MAX_THREADS];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    int total = count < 4000 ? count : 4000;
+    int adds;
+
+    for (int n = 1; n <= MAX_THREADS; n *= 4) {
+        for (int mode = 0; mode < 4; mode++) {
+            TodoDb *db = open_bench_db("durable");
+            if (!db) {
+                return;
+            }
+            TaskWriter *writer = mode ? start_task_writer(db, 256, mode == 1 ? 0 : 1000) : NULL;
+            atomic_store(&bench_completed, 0);
+
+            double start = now_seconds();
+            adds = total / n * n;
+            for (int i = 0; i < n; i++) {
+                threads[i] = (WriterBenchThread){.db = db, .lock = &lock, .writer = writer,
+                                                 .wait = mode < 3, .adds = total / n};
+                pthread_create(&ids[i], NULL, writer_bench_thread, &threads[i]);
+            }
+            for (int i = 0; i < n; i++) {
+                pthread_join(ids[i], NULL);
+            }
+
+            // Async producers return before their adds have committed.
+            while (mode == 3 && atomic_load(&bench_completed) < adds) {
+                usleep(100);
             }
+            double elapsed = now_seconds() - start;
+
+            size_t flushes = adds, mutations = adds;
+            if (writer) {
+                pthread_mutex_lock(&writer->lock);
+                flushes = writer->flushes;
+                mutations = writer->mutations;
+                pthread_mutex_unlock(&writer->lock);
+                stop_task_writer(writer);
+            }
+
+            printf("writer %2d threads  %-12s %8.0f adds/s  %6.1f adds per commit\n",
+                   n, modes[mode], adds / elapsed, (double)mutations / flushes);
+            close_db(db);
         }
     }
+    remove_bench_db();
+}
 
-    sqlite3_finalize(stmt);
-    return task;
-}
-
-void edit_task(sqlite3 *db, int task_id, Task updated_task) {
-    Task current_task;
-    
-    current_task = get_task_by_id(db, task_id);
-
-    const char* task_fields[] = {
-        updated_task.name ? updated_task.name : current_task.name,
-        updated_task.category ? updated_task.category : current_task.category,
-        updated_task.start_date ? updated_task.start_date : current_task.start_date,
-        updated_task.due_date ? updated_task.due_date : current_task.due_date,
-        updated_task.completion_date ? updated_task.completion_date : current_task.completion_date,
-        updated_task.status ? updated_task.status : current_task.status,
-        updated_task.priority ? updated_task.priority : current_task.priority,
-        updated_task.description ? updated_task.description : current_task.description
-    };
+static void count_async_result(TodoResult *result, void *arg)
+{
+    (*(int *)arg)++;
+}
 
-    sqlite3_stmt *stmt;
-    int rc;
-    const char *sql = "UPDATE Tasks SET Name = ?, Category = ?, StartDate = ?, DueDate = ?, CompletionDate = ?, Status = ?, Priority = ?, Description = ? WHERE Id = ?;";
+// Time the main thread spends per frame when each frame adds a task (and refetches every
+// 100th frame), calling the synchronous API directly against queuing async requests and
+// draining completions.
+static void bench_async(int count)
+{
+    enum { FRAMES = 2000 };
+    static double frame_times[FRAMES];
+    int frames = count < FRAMES ? count : FRAMES;
+    int completed = 0;
 
-    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db));
+    TodoDb *db = open_bench_db("durable");
+    if (!db) {
         return;
     }
+    for (int i = 0; i < frames; i++) {
+        double start = now_seconds();
+        add_task(db, bench_task);
+        if (i % 100 == 0) {
+            TaskList tasklist = fetch_tasks(db);
+            free_tasklist(&tasklist);
+        }
+        frame_times[i] = now_seconds() - start;
+    }
+    close_db(db);
+    qsort(frame_times, frames, sizeof(double), compare_doubles);
+    printf("frame sync   p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n", frame_times[frames / 2] * 1e3,
+           frame_times[frames * 99 / 100] * 1e3, frame_times[frames - 1] * 1e3);
 
-    for (int i = 0; i < 8; i++) {
-        sqlite3_bind_text(stmt, i + 1, task_fields[i], -1, SQLITE_TRANSIENT);
+    remove_bench_db();
+    TodoAsync *async = start_async(BENCH_DB, find_storage_profile("durable"), 2);
+    if (!async) {
+        return;
+    }
+    int requests = 0;
+    for (int i = 0; i < frames; i++) {
+        double start = now_seconds();
+        requests += add_task_async(async, &bench_task, count_async_result, &completed) == 0;
+        if (i % 100 == 0) {
+            requests += fetch_tasks_async(async, count_async_result, &completed) == 0;
+        }
+        drain_completions(async, 0);
+        frame_times[i] = now_seconds() - start;
+    }
+    double start = now_seconds();
+    while (completed < requests) {
+        drain_completions(async, 0);
+        usleep(100);
     }
+    double backlog = now_seconds() - start;
+    stop_async(async);
+    qsort(frame_times, frames, sizeof(double), compare_doubles);
+    printf("frame async  p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms  (backlog done %.1f ms after the last frame)\n",
+           frame_times[frames / 2] * 1e3, frame_times[frames * 99 / 100] * 1e3, frame_times[frames - 1] * 1e3,
+           backlog * 1e3);
+    remove_bench_db();
+}
 
-    sqlite3_bind_int(stmt, 9, task_id);
+// Seconds from opening the file to the first page of tasks. legacy re-creates the startup
+// main used to have: a throwaway connection that re-ran the DDL, then a second open.
+static double time_to_first_query(const StorageProfile *profile, int legacy)
+{
+    double start = now_seconds();
 
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_DONE) {
-        fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db));
-    } else {
-        printf("Task updated successfully\n");
+    if (legacy) {
+        sqlite3 *conn;
+        sqlite3_open(BENCH_DB, &conn);
+        apply_storage_profile(conn, profile);
+        sqlite3_exec(conn, V0_SCHEMA, 0, 0, NULL);
+        run_migrations(conn);
+        sqlite3_exec(conn, migrations[NUM_OF_MIGRATIONS - 1], 0, 0, NULL);
+        sqlite3_close(conn);
     }
 
-    sqlite3_finalize(stmt);
-
-    for (int i = 0; i < NUM_OF_COLS; i++) {
-        free(*((char **)&current_task + i));
+    TodoDb *db = open_db(BENCH_DB, profile);
+    if (!db) {
+        return 0;
     }
+    TaskPage page = fetch_tasks_page(db, NULL, 50, TASK_SORT_DUE_DATE);
+    double elapsed = now_seconds() - start;
+
+    free_tasklist(&page.list);
+    close_db(db);
+    return elapsed;
 }
 
-static int list_callback(void *NotUsed, int argc, char **argv, char **azColName)
+static void bench_startup(int count)
 {
-    for (int i = 0; i < argc; i++) {
-        printf("%s: %s\n", azColName[i], argv[i] ? argv[i]: "_");
+    static const char *modes[] = {"single open", "double open"};
+    enum { RUNS = 50 };
+    const StorageProfile *profile = find_storage_profile(DEFAULT_STORAGE_PROFILE);
+    double times[RUNS];
+
+    remove_bench_db();
+    printf("startup new file     %8.3f ms\n", time_to_first_query(profile, 0) * 1e3);
+
+    TodoDb *db = open_db(BENCH_DB, profile);
+    Task *tasks = calloc(count, sizeof(Task));
+    if (!db || !tasks) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        close_db(db);
+        return;
     }
-    printf("\n");
-    return 0;
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+        tasks[i].due_date = bench_task.due_date + i % 1000;
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+    close_db(db);
+
+    for (int legacy = 0; legacy <= 1; legacy++) {
+        for (int run = 0; run < RUNS; run++) {
+            times[run] = time_to_first_query(profile, legacy);
+        }
+        qsort(times, RUNS, sizeof(double), compare_doubles);
+        printf("startup %-12s p50 %8.3f ms  p99 %8.3f ms  (%d tasks)\n", modes[legacy],
+               times[RUNS / 2] * 1e3, times[RUNS * 99 / 100] * 1e3, count);
+    }
+    remove_bench_db();
 }
 
-void list_tasks(sqlite3 *db)
+// Single-row edits against db, returning the sorted per-edit latencies.
+static void time_edits(TodoDb *db, int count, int edits, double *latencies)
 {
-    char *err_msg = 0;
-    const char *sql = "SELECT * FROM Tasks;";
-    int rc = sqlite3_exec(db, sql, list_callback, 0, &err_msg);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to list tasks: %s\n", err_msg);
-        sqlite3_free(err_msg);
+    unsigned state = 7;
+
+    for (int i = 0; i < edits; i++) {
+        state = state * 1103515245 + 12345;
+        Task edit = {.priority = 1 + (state >> 4) % 3};
+        double start = now_seconds();
+        edit_task(db, 1 + (int)((state >> 8) % count), edit);
+        latencies[i] = now_seconds() - start;
     }
+    qsort(latencies, edits, sizeof(double), compare_doubles);
 }
 
-void delete_task(sqlite3 *db, int task_id)
+// Loading bench.db into memory, then edit latency on the file, in memory, and in memory while
+// snapshots run every 50 ms, copying a step of pages at a time or the whole file in one go.
+static void bench_memory(int count)
 {
-    sqlite3_stmt *stmt;
-    int rc;
-    const char *sql;
+    static const int steps[] = {DEFAULT_SNAPSHOT_PAGES, -1};
+    enum { LOADS = 5, EDITS = 20000 };
+    const StorageProfile *profile = find_storage_profile(DEFAULT_STORAGE_PROFILE);
+    double times[LOADS];
+    double *latencies = malloc(EDITS * sizeof(double));
 
-    sql = "DELETE FROM Tasks WHERE Id = ?;";
-    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot prepare statement: %s\n", sqlite3_errmsg(db));
+    TodoDb *db = open_bench_db("bulk-load");
+    Task *tasks = calloc(count, sizeof(Task));
+    if (!db || !tasks || !latencies) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        free(tasks);
+        free(latencies);
+        close_db(db);
         return;
     }
+    for (int i = 0; i < count; i++) {
+        tasks[i] = bench_task;
+        tasks[i].due_date = bench_task.due_date + i % 1000;
+    }
+    add_tasks(db, tasks, count, NULL);
+    free(tasks);
+    close_db(db);
 
-    sqlite3_bind_int(stmt, 1, task_id);
+    for (int run = 0; run < LOADS; run++) {
+        double start = now_seconds();
+        db = open_memory_db(BENCH_DB, profile);
+        times[run] = now_seconds() - start;
+        close_db(db);
+    }
+    qsort(times, LOADS, sizeof(double), compare_doubles);
+    printf("memory load %8d tasks  p50 %8.1f ms\n", count, times[LOADS / 2] * 1e3);
 
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_DONE) {
-        fprintf(stderr, "Execution failed: %s\n", sqlite3_errmsg(db));
-    } else {
-        printf("Task deleted successfully\n");
+    db = open_db(BENCH_DB, profile);
+    if (db) {
+        time_edits(db, count, EDITS, latencies);
+        printf("memory edit %-18s p50 %7.1f us  p99 %7.1f us  max %8.1f us\n", "on file",
+               latencies[EDITS / 2] * 1e6, latencies[EDITS * 99 / 100] * 1e6, latencies[EDITS - 1] * 1e6);
+        close_db(db);
     }
 
-    sqlite3_finalize(stmt);
+    db = open_memory_db(BENCH_DB, profile);
+    if (db) {
+        time_edits(db, count, EDITS, latencies);
+        printf("memory edit %-18s p50 %7.1f us  p99 %7.1f us  max %8.1f us\n", "in memory",
+               latencies[EDITS / 2] * 1e6, latencies[EDITS * 99 / 100] * 1e6, latencies[EDITS - 1] * 1e6);
+
+        for (size_t k = 0; k < sizeof(steps) / sizeof(steps[0]); k++) {
+            char label[32];
+            SnapshotStats stats;
+            TodoSnapshotter *snapshotter = start_snapshots(db, BENCH_DB, profile, 0.05, steps[k]);
+            if (!snapshotter) {
+                break;
+            }
+            time_edits(db, count, EDITS, latencies);
+            stop_snapshots(snapshotter, &stats);
+
+            snprintf(label, sizeof(label), "snapshot step %d", steps[k]);
+            printf("memory edit %-18s p50 %7.1f us  p99 %7.1f us  max %8.1f us  %zu snapshots  avg %.1f ms  max %.1f ms\n",
+                   label, latencies[EDITS / 2] * 1e6, latencies[EDITS * 99 / 100] * 1e6, latencies[EDITS - 1] * 1e6,
+                   stats.snapshots, stats.snapshots ? stats.total_seconds / stats.snapshots * 1e3 : 0,
+                   stats.max_seconds * 1e3);
+        }
+        close_db(db);
+    }
+
+    free(latencies);
+    remove_bench_db();
 }
 
-typedef struct {
-    Task *tasks;
-    size_t count;
-} TaskList;
+#define BENCH_CSV "bench-storage.csv"
 
-TaskList fetch_tasks(sqlite3 *db) {
-    TaskList tasklist = {NULL, 0};
-    sqlite3_stmt *stmt;
-    const char *sql;
+// Point lookups, due-date range scans and a full fetch_tasks under every combination of page
+// size, page cache size and mmap size, at 10k, 100k and 1M rows (as far as count allows).
+// Results also go to BENCH_CSV. The OS page cache stays warm across runs, so what mmap saves
+// here is the copy into SQLite's own cache, not disk reads.
+static void bench_storage(int count)
+{
+    static const int sizes[] = {10000, 100000, 1000000};
+    static const int page_sizes[] = {4096, 16384};
+    static const int cache_sizes[] = {-2000, -65536};
+    static const sqlite3_int64 mmap_sizes[] = {0, 64 * 1024 * 1024, 1024 * 1024 * 1024};
+    enum { LOOKUPS = 20000, RANGES = 200, RANGE_DAYS = 7, DUE_SPREAD = 3650 };
 
-    sql = "SELECT Id, Name, Category, StartDate, DueDate, CompletionDate, Status, Priority, Description FROM Tasks;";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        return tasklist;
+    FILE *csv = fopen(BENCH_CSV, "w");
+    if (!csv) {
+        fprintf(stderr, "Cannot open %s\n", BENCH_CSV);
+        return;
     }
+    fprintf(csv, "rows,page_size,cache_kib,mmap_mib,point_lookups_per_sec,range_scan_ms,range_rows,fetch_all_ms\n");
 
-    size_t capacity = 10;
-    tasklist.tasks = malloc(capacity * sizeof(Task));
-    if (!tasklist.tasks) {
-        fprintf(stderr, "Failed to allocate memory\n");
-        sqlite3_finalize(stmt);
-        return tasklist;
-    }
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && (s == 0 || sizes[s - 1] < count); s++) {
+        int rows = sizes[s] < count ? sizes[s] : count;
+        TodoDb *db = open_bench_db("bulk-load");
+        Task *tasks = calloc(rows, sizeof(Task));
+        if (!db || !tasks) {
+            fprintf(stderr, "Failed to allocate memory\n");
+            free(tasks);
+            close_db(db);
+            break;
+        }
+        for (int i = 0; i < rows; i++) {
+            tasks[i] = bench_task;
+            tasks[i].due_date = bench_task.due_date + i % DUE_SPREAD;
+        }
+        add_tasks(db, tasks, rows, NULL);
+        free(tasks);
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (tasklist.count >= capacity) {
-            capacity *= 2;
-            Task *temp = realloc(tasklist.tasks, capacity * sizeof(Task));
-            if (!temp) {
-                fprintf(stderr, "Failed to realloc memory\n");
+        for (size_t p = 0; p < sizeof(page_sizes) / sizeof(page_sizes[0]); p++) {
+            if (change_page_size(db, page_sizes[p]) != SQLITE_OK) {
                 break;
             }
-            tasklist.tasks = temp;
+
+            for (size_t c = 0; c < sizeof(cache_sizes) / sizeof(cache_sizes[0]); c++) {
+                for (size_t m = 0; m < sizeof(mmap_sizes) / sizeof(mmap_sizes[0]); m++) {
+                    StorageProfile profile = *find_storage_profile(DEFAULT_STORAGE_PROFILE);
+                    profile.page_size = page_sizes[p];
+                    profile.cache_size = cache_sizes[c];
+                    profile.mmap_size = mmap_sizes[m];
+
+                    TodoDb *reader = open_db(BENCH_DB, &profile);
+                    if (!reader) {
+                        break;
+                    }
+                    // Every lookup has to reach SQLite, or this only measures the task cache.
+                    set_task_cache_limit(reader, 0);
+
+                    unsigned state = 1;
+                    double start = now_seconds();
+                    for (int i = 0; i < LOOKUPS; i++) {
+                        state = state * 1103515245 + 12345;
+                        get_task_by_id(reader, 1 + (int)((state >> 8) % rows));
+                    }
+                    double point = now_seconds() - start;
+
+                    size_t range_rows = 0;
+                    start = now_seconds();
+                    for (int i = 0; i < RANGES; i++) {
+                        state = state * 1103515245 + 12345;
+                        TaskFilter filter = {0};
+                        filter.due_from = bench_task.due_date + (int)((state >> 8) % (DUE_SPREAD - RANGE_DAYS));
+                        filter.due_to = filter.due_from + RANGE_DAYS - 1;
+                        TaskList list = fetch_tasks_where(reader, &filter);
+                        range_rows += list.count;
+                        free_tasklist(&list);
+                    }
+                    double range = now_seconds() - start;
+
+                    start = now_seconds();
+                    TaskList all = fetch_tasks(reader);
+                    double full = now_seconds() - start;
+                    free_tasklist(&all);
+
+                    printf("storage %7d rows  page %5d  cache %6d KiB  mmap %4lld MiB  %8.0f lookups/s  range %7.3f ms  fetch_tasks %8.1f ms\n",
+                           rows, page_sizes[p], -cache_sizes[c], (long long)(mmap_sizes[m] >> 20),
+                           LOOKUPS / point, range / RANGES * 1e3, full * 1e3);
+                    fprintf(csv, "%d,%d,%d,%lld,%.0f,%.4f,%zu,%.2f\n",
+                            rows, page_sizes[p], -cache_sizes[c], (long long)(mmap_sizes[m] >> 20),
+                            LOOKUPS / point, range / RANGES * 1e3, range_rows / RANGES, full * 1e3);
+                    close_db(reader);
+                }
+            }
+        }
+        close_db(db);
+    }
+
+    fclose(csv);
+    remove_bench_db();
+    printf("storage results written to %s\n", BENCH_CSV);
+}
+
+static void bench_commit_latency_capped(int count)
+{
+    bench_commit_latency(count < 2000 ? count : 2000);
+}
+
+static const struct {
+    const char *name;
+    void (*run)(int count);
+} benchmarks[] = {
+    {"inserts", bench_inserts},
+    {"group-commit", bench_group_commit},
+    {"commit-latency", bench_commit_latency_capped},
+    {"pagination", bench_pagination},
+    {"fetch-memory", bench_fetch_memory},
+    {"columns", bench_columns},
+    {"search", bench_search},
+    {"cache", bench_cache},
+    {"reader-pool", bench_reader_pool},
+    {"writer", bench_writer},
+    {"async", bench_async},
+    {"startup", bench_startup},
+    {"storage", bench_storage},
+    {"memory", bench_memory},
+    {"import", bench_import},
+    {"export", bench_export},
+    {"image", bench_image},
+};
+
+#define NUM_OF_BENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+// Lands the final snapshot of an in-memory session before closing it.
+static int end_session(TodoDb *db, TodoSnapshotter *snapshotter, int rc)
+{
+    if (snapshotter) {
+        SnapshotStats stats;
+
+        stop_snapshots(snapshotter, &stats);
+        if (stats.snapshots) {
+            fprintf(stderr, "%zu snapshots to todo.db, last %.1f ms, max %.1f ms\n",
+                    stats.snapshots, stats.last_seconds * 1e3, stats.max_seconds * 1e3);
         }
+    }
+    close_db(db);
+    return rc;
+}
 
-        Task *task = &tasklist.tasks[tasklist.count++];
-        task->id = sqlite3_column_int(stmt, 0);
-        task->name = strdup((const char *)sqlite3_column_text(stmt, 1));
-        task->category = strdup((const char *)sqlite3_column_text(stmt, 2));
-        task->start_date = strdup((const char *)sqlite3_column_text(stmt, 3));
-        task->due_date = strdup((const char *)sqlite3_column_text(stmt, 4));
-        task->completion_date = strdup((const char *)sqlite3_column_text(stmt, 5));
-        task->status = strdup((const char *)sqlite3_column_text(stmt, 6));
-        task->priority = strdup((const char *)sqlite3_column_text(stmt, 7));
-        task->description = strdup((const char *)sqlite3_column_text(stmt, 8));
+// ./todo bench [count] [NAME...]: every benchmark, or only the named ones.
+static int run_benchmarks(int argc, char **argv)
+{
+    int count = argc > 0 ? atoi(argv[0]) : 100000;
+    if (count <= 0) {
+        fprintf(stderr, "usage: todo bench [count] [NAME...]\n");
+        return 1;
     }
 
-    sqlite3_finalize(stmt);
-    return tasklist;
+    for (int i = 1; i < argc; i++) {
+        size_t k = 0;
+        while (k < NUM_OF_BENCHMARKS && strcmp(argv[i], benchmarks[k].name) != 0) {
+            k++;
+        }
+        if (k == NUM_OF_BENCHMARKS) {
+            fprintf(stderr, "Unknown benchmark: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    bench_task.due_date = parse_date("01-20-2024");
+
+    for (size_t k = 0; k < NUM_OF_BENCHMARKS; k++) {
+        int selected = argc < 2;
+        for (int i = 1; i < argc && !selected; i++) {
+            selected = strcmp(argv[i], benchmarks[k].name) == 0;
+        }
+        if (selected) {
+            benchmarks[k].run(count);
+        }
+    }
+    return 0;
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    sqlite3 *db;
-    int rc;
+    TodoDb *db;
+    TodoSnapshotter *snapshotter = NULL;
+    const StorageProfile *profile;
+    StorageProfile tuned;
+    const char *profile_name = getenv("TODO_STORAGE_PROFILE");
+    const char *memory_window = getenv("TODO_MEMORY_WINDOW");
+
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        return run_benchmarks(argc - 2, argv + 2);
+    }
 
     // const int screenWidth = 800;
     // const int screenHeight = 450;
     // Color background_color = RAYWHITE;
 
-    initialize_db();
-
-    rc = sqlite3_open("todo.db", &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Error opening: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
+    profile = find_storage_profile(profile_name ? profile_name : DEFAULT_STORAGE_PROFILE);
+    if (!profile) {
         return 1;
     }
-    
-    // TaskList tasklist = fetch_tasks(db);
+
+    tuned = tune_storage_profile(profile);
+    if (memory_window) {
+        // TODO_MEMORY_WINDOW=SECONDS: run in memory, losing at most about that much on a crash.
+        double start = now_seconds();
+        db = open_memory_db("todo.db", &tuned);
+        if (!db) {
+            return 1;
+        }
+        fprintf(stderr, "Loaded todo.db into memory in %.1f ms\n", (now_seconds() - start) * 1e3);
+
+        snapshotter = start_snapshots(db, "todo.db", &tuned, atof(memory_window), DEFAULT_SNAPSHOT_PAGES);
+        if (!snapshotter) {
+            close_db(db);
+            return 1;
+        }
+    } else {
+        db = open_db("todo.db", &tuned);
+        if (!db) {
+            return 1;
+        }
+    }
+
+    if (argc > 1 && strcmp(argv[1], "plans") == 0) {
+        int rc = check_query_plans(db);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "statuses") == 0) {
+        int rc = manage_statuses(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "categories") == 0) {
+        int rc = manage_categories(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "changes") == 0) {
+        int rc = changes_command(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "search") == 0) {
+        int rc = search_command(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "search-index") == 0) {
+        int rc = manage_search_index(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "export") == 0) {
+        int rc = export_command(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "image") == 0) {
+        int rc = image_command(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "import") == 0) {
+        int rc = import_command(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "page-size") == 0) {
+        int rc = page_size_command(db, argc - 2, argv + 2);
+        return end_session(db, snapshotter, rc);
+    }
 
     // InitWindow(screenWidth, screenHeight, "Raylib test");
 
@@ -294,51 +6178,33 @@ int main()
     // CloseWindow();
     Task newTask = {
         .name = "TaskName",
-        .due_date = "01-20-2024",
+        .due_date = parse_date("01-20-2024"),
         .description = "Sample Task Description",
     };
 
-    add_task(db, newTask);
-    add_task(db, newTask);
+    for (int i = 0; i < 2; i++) {
+        if (add_task(db, newTask) >= 0) {
+            printf("Task added successfully\n");
+        }
+    }
 
     Task updateTask = {
         .name = "testing_new_edit",
-        .priority = "low",
+        .priority = priority_code(db, "low"),
         .category = "programming",
-        .due_date = "02-02-2024"
+        .due_date = parse_date("02-02-2024")
     };
 
-    edit_task(db, 1, updateTask);
-    
-    list_tasks(db);
-
-    // for (size_t i = 0; i < tasklist.count; i++) {
-    //     Task *task = &tasklist.tasks[i];
-    //     printf("Task %zu: \n", i + 1);
-    //     printf("ID: %d\n", task->id);
-    //     printf("Name: %s\n", task->name);
-    //     printf("Category: %s\n", task->category);
-    //     printf("Start Date: %s\n", task->start_date);
-    //     printf("Due Date: %s\n", task->due_date);
-    //     printf("Completion Date: %s\n", task->completion_date);
-    //     printf("Status: %s\n", task->status);
-    //     printf("Priority: %s\n", task->priority);
-    //     printf("Description: %s\n\n", task->description);
-    // }
-
-    // for (size_t i = 0; i < tasklist.count; i++) {
-    //     free(tasklist.tasks[i].name);
-    //     free(tasklist.tasks[i].category);
-    //     free(tasklist.tasks[i].start_date);
-    //     free(tasklist.tasks[i].due_date);
-    //     free(tasklist.tasks[i].completion_date);
-    //     free(tasklist.tasks[i].status);
-    //     free(tasklist.tasks[i].priority);
-    //     free(tasklist.tasks[i].description);
-    // }
-    // free(tasklist.tasks);
+    switch (edit_task(db, 1, updateTask)) {
+    case 1:
+        printf("Task updated successfully\n");
+        break;
+    case 0:
+        fprintf(stderr, "No task with id %d\n", 1);
+        break;
+    }
 
-    sqlite3_close(db);
+    list_tasks(db);
 
-    return 0;
+    return end_session(db, snapshotter, 0);
 }